@@ -0,0 +1,166 @@
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string_view>
+#include <vector>
+
+#include "../../Typoon/utils/latency_probe.h"
+#include "../util/benchmark.h"
+#include "../util/match_generator.h"
+#include "../util/peak_memory.h"
+
+
+void run_string_benchmarks(std::vector<BenchmarkResult>& results);
+void run_match_benchmarks(std::vector<BenchmarkResult>& results, const MatchSetOptions& options, size_t keystrokeCount);
+bool run_replay_benchmarks(std::vector<BenchmarkResult>& results, const std::filesystem::path& traceFile, const std::filesystem::path& matchFile);
+
+
+constexpr std::string_view USAGE =
+    "Usage: Benchmark [options]\n"
+    "  --matches <count>         The number of the matches generated. (default: 10000)\n"
+    "  --fan-out <count>         The number of different letters at each position of the triggers. (default: 8)\n"
+    "  --trigger-length <count>  The average length of the triggers. (default: 6)\n"
+    "  --korean-ratio <ratio>    How many of the triggers and the words typed are Korean, from 0 to 1. (default: 0.3)\n"
+    "  --keystrokes <count>      The number of the keys typed for the latencies. (default: 200000)\n"
+    "  --seed <seed>             (default: 0)\n"
+    "  --skip-string             Skip the string benchmarks.\n"
+    "  --replay <trace file>     Only replay an input trace recorded with `Typoon --capture-input`, needs --match-file.\n"
+    "  --match-file <file>       The match file to replay the trace against.\n"
+    "  --json <file>             Write the results to the file as JSON, '-' for the standard output.\n";
+
+
+template<typename T>
+bool parse_argument(std::string_view argument, T& out)
+{
+    const auto [end, error] = std::from_chars(argument.data(), argument.data() + argument.size(), out);
+    return error == std::errc{} && end == argument.data() + argument.size();
+}
+
+
+int main(int argc, char** argv)
+{
+    MatchSetOptions options;
+    size_t keystrokeCount = 200000;
+    bool doSkipStringBenchmarks = false;
+    std::string jsonFile;
+    std::filesystem::path traceFile;
+    std::filesystem::path matchFile;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string_view option = argv[i];
+        const std::string_view argument = i + 1 < argc ? argv[i + 1] : "";
+        bool isValid = true;
+        if (option == "--skip-string")
+        {
+            doSkipStringBenchmarks = true;
+            continue;
+        }
+        else if (option == "--matches")
+        {
+            isValid = parse_argument(argument, options.matchCount);
+        }
+        else if (option == "--fan-out")
+        {
+            isValid = parse_argument(argument, options.fanOut) && options.fanOut > 0;
+        }
+        else if (option == "--trigger-length")
+        {
+            isValid = parse_argument(argument, options.triggerLength) && options.triggerLength > 0;
+        }
+        else if (option == "--korean-ratio")
+        {
+            isValid = parse_argument(argument, options.koreanRatio) && 0 <= options.koreanRatio && options.koreanRatio <= 1;
+        }
+        else if (option == "--keystrokes")
+        {
+            isValid = parse_argument(argument, keystrokeCount) && keystrokeCount > 0;
+        }
+        else if (option == "--seed")
+        {
+            isValid = parse_argument(argument, options.seed);
+        }
+        else if (option == "--replay")
+        {
+            traceFile = argument;
+            isValid = !traceFile.empty();
+        }
+        else if (option == "--match-file")
+        {
+            matchFile = argument;
+            isValid = !matchFile.empty();
+        }
+        else if (option == "--json")
+        {
+            jsonFile = argument;
+            isValid = !jsonFile.empty();
+        }
+        else
+        {
+            isValid = false;
+        }
+
+        if (!isValid)
+        {
+            std::cerr << "Invalid option: " << option << ' ' << argument << "\n\n" << USAGE;
+            return 1;
+        }
+        i++;
+    }
+
+    if (!traceFile.empty() && matchFile.empty())
+    {
+        std::cerr << "--replay needs --match-file\n\n" << USAGE;
+        return 1;
+    }
+
+    std::vector<BenchmarkResult> results;
+    if (!traceFile.empty())
+    {
+        if (!run_replay_benchmarks(results, traceFile, matchFile))
+        {
+            return 1;
+        }
+    }
+    else
+    {
+        // The match benchmarks go first, so that the peak memory they report is of their own.
+        run_match_benchmarks(results, options, keystrokeCount);
+        if (!doSkipStringBenchmarks)
+        {
+            run_string_benchmarks(results);
+        }
+    }
+
+    if (jsonFile.empty())
+    {
+        print_benchmark_results(results);
+        std::cout << "Peak memory: " << get_peak_memory_usage() << " bytes\n\n" << get_latency_report();
+        return 0;
+    }
+
+    const std::vector<std::pair<std::string, double>> context{
+        { "matches", static_cast<double>(options.matchCount) },
+        { "fan_out", options.fanOut },
+        { "trigger_length", options.triggerLength },
+        { "korean_ratio", options.koreanRatio },
+        { "keystrokes", static_cast<double>(keystrokeCount) },
+        { "seed", options.seed },
+        { "peak_memory_bytes", static_cast<double>(get_peak_memory_usage()) },
+    };
+    if (jsonFile == "-")
+    {
+        write_benchmark_results_json(std::cout, results, context);
+    }
+    else if (std::ofstream ofs{ jsonFile }; ofs)
+    {
+        write_benchmark_results_json(ofs, results, context);
+    }
+    else
+    {
+        std::cerr << "Failed to open " << jsonFile << '\n';
+        return 1;
+    }
+    return 0;
+}
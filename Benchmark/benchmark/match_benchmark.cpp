@@ -0,0 +1,66 @@
+#include <chrono>
+#include <format>
+#include <vector>
+
+#include "../../Typoon/imm/imm_simulator.h"
+#include "../../Typoon/match/trigger_tree.h"
+#include "../../UnitTest/util/config.h"
+#include "../../UnitTest/util/text_editor_simulator.h"
+#include "../util/benchmark.h"
+#include "../util/match_generator.h"
+#include "../util/peak_memory.h"
+
+
+void run_match_benchmarks(std::vector<BenchmarkResult>& results, const MatchSetOptions& options, size_t keystrokeCount)
+{
+    const GeneratedMatchSet matchSet = generate_match_set(options);
+    const std::wstring typing = generate_typing(matchSet, options, keystrokeCount);
+
+    set_config({ .maxBackspaceCount = 5, .cursorPlaceholder = L"|_|" });
+    BenchmarkResult& construction = results.emplace_back(run_benchmark("trigger_tree/construction", matchSet.matchesString.size(),
+        [&matchSet]
+        {
+            TriggerTree tree{ "" };
+            tree.Reconstruct(matchSet.matchesString);
+            tree.WaitForConstruction();
+            return matchSet.triggers.size();
+        }, std::chrono::seconds{ 1 }));
+    construction.metrics.emplace_back("matches", static_cast<double>(matchSet.triggers.size()));
+    construction.metrics.emplace_back("peak_memory_bytes", static_cast<double>(get_peak_memory_usage()));
+
+    for (const auto& [engineName, engine] : { std::pair{ "agents", Config::EMatchEngine::AGENTS }, std::pair{ "automaton", Config::EMatchEngine::AUTOMATON } })
+    {
+        set_config({ .maxBackspaceCount = 5, .cursorPlaceholder = L"|_|", .matchEngine = engine });
+        TriggerTree tree{ "" };
+        tree.Reconstruct(matchSet.matchesString);
+        tree.WaitForConstruction();
+        text_editor_simulator.Reset();
+
+        // Only `OnInput` is timed, not the composition before it. The replacements are typed into `text_editor_simulator`.
+        std::vector<double> latencies;
+        latencies.reserve(typing.size() * MAX_INPUT_COUNT);
+        ImmSimulator immSimulator;
+        immSimulator.RedirectInputMulticast([&tree, &latencies](const InputMessage(&inputs)[MAX_INPUT_COUNT], int length)
+            {
+                const auto start = std::chrono::steady_clock::now();
+                tree.OnInput(inputs, length, false);
+                latencies.emplace_back(static_cast<double>(std::chrono::nanoseconds{ std::chrono::steady_clock::now() - start }.count()));
+            });
+
+        const auto start = std::chrono::steady_clock::now();
+        for (const wchar_t letter : typing)
+        {
+            immSimulator.AddLetter(letter);
+        }
+        const std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start;
+
+        BenchmarkResult& onInput = results.emplace_back(BenchmarkResult{
+            .name = std::format("trigger_tree/on_input/{}", engineName),
+            .iterations = typing.size(),
+            .nanosecondsPerIteration = static_cast<double>(elapsed.count()) / static_cast<double>(typing.size()),
+            .bytesPerSecond = 0,
+            .metrics = summarize_latencies(latencies),
+        });
+        onInput.metrics.emplace_back("peak_memory_bytes", static_cast<double>(get_peak_memory_usage()));
+    }
+}
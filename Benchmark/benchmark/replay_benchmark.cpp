@@ -0,0 +1,75 @@
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <vector>
+
+#include "../../Typoon/input_multicast/input_trace.h"
+#include "../../Typoon/match/trigger_tree.h"
+#include "../../UnitTest/util/config.h"
+#include "../../UnitTest/util/text_editor_simulator.h"
+#include "../util/benchmark.h"
+#include "../util/peak_memory.h"
+
+
+// Replays a trace recorded with `--capture-input` against `matchFile`, as fast as possible.
+// The trace has the inputs after the IMM composed them, so they go to `OnInput` as-is. The replacements go through the IMM of `text_editor_simulator`.
+bool run_replay_benchmarks(std::vector<BenchmarkResult>& results, const std::filesystem::path& traceFile, const std::filesystem::path& matchFile)
+{
+    std::vector<InputTraceEvent> events;
+    if (!read_input_trace(traceFile, events))
+    {
+        std::cerr << "Invalid input trace: " << traceFile << '\n';
+        return false;
+    }
+    if (events.empty())
+    {
+        std::cerr << "The input trace is empty: " << traceFile << '\n';
+        return false;
+    }
+
+    for (const auto& [engineName, engine] : { std::pair{ "agents", Config::EMatchEngine::AGENTS }, std::pair{ "automaton", Config::EMatchEngine::AUTOMATON } })
+    {
+        set_config({ .maxBackspaceCount = 5, .cursorPlaceholder = L"|_|", .matchEngine = engine });
+        TriggerTree tree{ matchFile };
+        tree.Reconstruct();
+        tree.WaitForConstruction();
+        text_editor_simulator.Reset();
+
+        std::vector<double> inputLatencies;
+        std::vector<double> clearLatencies;
+        inputLatencies.reserve(events.size());
+        for (const InputTraceEvent& event : events)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            tree.OnInput(event.inputs, event.length, event.clearAllAgents);
+            const auto latency = static_cast<double>(std::chrono::nanoseconds{ std::chrono::steady_clock::now() - start }.count());
+            (event.clearAllAgents ? clearLatencies : inputLatencies).emplace_back(latency);
+        }
+
+        const auto lambdaAddResult = [&results, engineName](std::string_view eventName, std::vector<double>& latencies) -> BenchmarkResult&
+            {
+                std::vector<std::pair<std::string, double>> histogram = make_latency_histogram(latencies);
+                BenchmarkResult& result = results.emplace_back(BenchmarkResult{
+                    .name = std::format("replay/{}/{}", eventName, engineName),
+                    .iterations = latencies.size(),
+                    .metrics = summarize_latencies(latencies),
+                });
+                if (!latencies.empty())
+                {
+                    result.nanosecondsPerIteration = result.metrics.front().second;  // The mean.
+                }
+                result.metrics.insert(result.metrics.end(), histogram.begin(), histogram.end());
+                return result;
+            };
+
+        BenchmarkResult& inputResult = lambdaAddResult("input", inputLatencies);
+        inputResult.metrics.emplace_back("expansions", static_cast<double>(text_editor_simulator.GetFakeInputsCount()));
+        inputResult.metrics.emplace_back("trace_seconds", std::chrono::duration<double>{ events.back().time }.count());
+        inputResult.metrics.emplace_back("peak_memory_bytes", static_cast<double>(get_peak_memory_usage()));
+        if (!clearLatencies.empty())
+        {
+            lambdaAddResult("clear", clearLatencies);
+        }
+    }
+    return true;
+}
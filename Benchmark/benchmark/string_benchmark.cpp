@@ -0,0 +1,89 @@
+#include <format>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "../../Typoon/utils/string.h"
+#include "../util/benchmark.h"
+
+
+// Something like a match file, of which `koreanRatio` of the words are Korean.
+std::wstring generate_match_file_text(size_t length, double koreanRatio)
+{
+    constexpr std::wstring_view englishWords[] = {
+        L"the", L"quick", L"brown", L"fox", L"jumps", L"over", L"lazy", L"dog", L"address", L"email", L"signature", L"regards", L"Typoon"
+    };
+
+    std::mt19937 random{ 0 };
+    std::bernoulli_distribution isKorean{ koreanRatio };
+    std::uniform_int_distribution<int> wordCount{ 1, 6 };
+    std::uniform_int_distribution<int> syllableCount{ 1, 4 };
+    std::uniform_int_distribution<int> syllable{ L'가', L'힣' };
+    std::uniform_int_distribution<size_t> englishWord{ 0, std::size(englishWords) - 1 };
+
+    const auto lambdaAppendWords = [&](std::wstring& text)
+        {
+            for (int i = wordCount(random); i > 0; i--)
+            {
+                if (isKorean(random))
+                {
+                    for (int j = syllableCount(random); j > 0; j--)
+                    {
+                        text += static_cast<wchar_t>(syllable(random));
+                    }
+                }
+                else
+                {
+                    text += englishWords[englishWord(random)];
+                }
+                text += i > 1 ? L" " : L"";
+            }
+        };
+
+    std::wstring text;
+    while (text.size() < length)
+    {
+        text += L"  - trigger: \"";
+        lambdaAppendWords(text);
+        text += L"\"\n    replace: \"";
+        lambdaAppendWords(text);
+        text += L"\"\n";
+    }
+    return text;
+}
+
+
+void run_string_benchmarks(std::vector<BenchmarkResult>& results)
+{
+    constexpr size_t textLength = 1 << 20;
+    constexpr std::pair<std::string_view, double> texts[] = {
+        { "English", 0.0 },
+        { "Mixed", 0.5 },
+        { "Korean", 1.0 },
+    };
+
+    std::wstring buffer;
+    for (const auto& [textName, koreanRatio] : texts)
+    {
+        const std::wstring text = generate_match_file_text(textLength, koreanRatio);
+        const std::wstring normalized = normalize_hangeul(text);
+        const std::wstring alphabets = hangeul_to_alphabet(normalized, false);
+        const size_t bytes = text.size() * sizeof(wchar_t);
+
+        results.emplace_back(run_benchmark(std::format("normalize_hangeul/allocating/{}", textName), bytes,
+            [&text] { return normalize_hangeul(text).size(); }));
+        results.emplace_back(run_benchmark(std::format("normalize_hangeul/reused_string/{}", textName), bytes,
+            [&text, &buffer] { normalize_hangeul(text, buffer); return buffer.size(); }));
+
+        buffer.resize(text.size() * MAX_NORMALIZED_HANGEUL_LENGTH);
+        results.emplace_back(run_benchmark(std::format("normalize_hangeul/span/{}", textName), bytes,
+            [&text, &buffer] { return normalize_hangeul(text, std::span{ buffer }); }));
+
+        buffer.resize(normalized.size());
+        results.emplace_back(run_benchmark(std::format("hangeul_to_alphabet/span/{}", textName), normalized.size() * sizeof(wchar_t),
+            [&normalized, &buffer] { return hangeul_to_alphabet(normalized, false, std::span{ buffer }); }));
+        results.emplace_back(run_benchmark(std::format("alphabet_to_hangeul/span/{}", textName), alphabets.size() * sizeof(wchar_t),
+            [&alphabets, &buffer] { return alphabet_to_hangeul(alphabets, std::span{ buffer }); }));
+    }
+}
@@ -0,0 +1,141 @@
+#include "benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <format>
+#include <iostream>
+#include <map>
+#include <numeric>
+
+
+// Where the results of the bodies go, so that the compiler can't drop the work.
+volatile size_t benchmark_sink = 0;
+
+
+BenchmarkResult run_benchmark(std::string name, size_t bytesPerIteration, const std::function<size_t()>& body, std::chrono::nanoseconds minDuration)
+{
+    benchmark_sink = benchmark_sink + body();
+
+    // Grow the batch until it's long enough, so that reading the clock doesn't dominate short bodies.
+    size_t iterations = 0;
+    std::chrono::nanoseconds elapsed{ 0 };
+    for (size_t batchSize = 1; elapsed < minDuration; batchSize *= 2)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < batchSize; i++)
+        {
+            benchmark_sink = benchmark_sink + body();
+        }
+        elapsed += std::chrono::steady_clock::now() - start;
+        iterations += batchSize;
+    }
+
+    const double nanosecondsPerIteration = static_cast<double>(elapsed.count()) / static_cast<double>(iterations);
+    return {
+        .name = std::move(name),
+        .iterations = iterations,
+        .nanosecondsPerIteration = nanosecondsPerIteration,
+        .bytesPerSecond = static_cast<double>(bytesPerIteration) * 1e9 / nanosecondsPerIteration,
+    };
+}
+
+
+std::vector<std::pair<std::string, double>> summarize_latencies(std::vector<double>& latencies)
+{
+    if (latencies.empty())
+    {
+        return {};
+    }
+
+    std::ranges::sort(latencies);
+    const auto lambdaPercentile = [&latencies](double percentile)
+        {
+            const auto index = static_cast<size_t>(std::ceil(percentile / 100 * static_cast<double>(latencies.size())));
+            return latencies[std::clamp<size_t>(index, 1, latencies.size()) - 1];
+        };
+    return {
+        { "mean_ns", std::accumulate(latencies.begin(), latencies.end(), 0.0) / static_cast<double>(latencies.size()) },
+        { "p50_ns", lambdaPercentile(50) },
+        { "p90_ns", lambdaPercentile(90) },
+        { "p99_ns", lambdaPercentile(99) },
+        { "p99.9_ns", lambdaPercentile(99.9) },
+        { "max_ns", latencies.back() },
+    };
+}
+
+
+std::vector<std::pair<std::string, double>> make_latency_histogram(const std::vector<double>& latencies)
+{
+    std::map<int, size_t> counts;
+    for (const double latency : latencies)
+    {
+        counts[latency < 1 ? 0 : std::ilogb(latency)]++;
+    }
+
+    std::vector<std::pair<std::string, double>> histogram;
+    for (const auto& [exponent, count] : counts)
+    {
+        histogram.emplace_back(std::format("histogram_{}_{}_ns", exponent == 0 ? 0ULL : 1ULL << exponent, 1ULL << (exponent + 1)), static_cast<double>(count));
+    }
+    return histogram;
+}
+
+
+void print_benchmark_results(const std::vector<BenchmarkResult>& results)
+{
+    size_t nameWidth = 0;
+    for (const BenchmarkResult& result : results)
+    {
+        nameWidth = std::max(nameWidth, result.name.size());
+    }
+
+    for (const BenchmarkResult& result : results)
+    {
+        std::cout << result.name << std::string(nameWidth - result.name.size() + 2, ' ')
+            << std::format("{:>14.1f} ns/iter", result.nanosecondsPerIteration);
+        if (result.bytesPerSecond > 0)
+        {
+            std::cout << std::format("{:>10.1f} MB/s", result.bytesPerSecond / (1024 * 1024));
+        }
+        std::cout << std::format("  ({} iterations)\n", result.iterations);
+        for (const auto& [metric, value] : result.metrics)
+        {
+            std::cout << std::format("    {:<24}{:>14.1f}\n", metric, value);
+        }
+    }
+}
+
+
+void write_benchmark_results_json(std::ostream& os, const std::vector<BenchmarkResult>& results, const std::vector<std::pair<std::string, double>>& context)
+{
+    // The names are all ours, so nothing needs to be escaped.
+    const auto lambdaWriteMetrics = [&os](const std::vector<std::pair<std::string, double>>& metrics, std::string_view indent, bool isLast)
+        {
+            for (size_t i = 0; i < metrics.size(); i++)
+            {
+                os << std::format("{}\"{}\": {}{}\n", indent, metrics[i].first, metrics[i].second, isLast && i + 1 == metrics.size() ? "" : ",");
+            }
+        };
+
+    os << "{\n  \"context\": {\n";
+    lambdaWriteMetrics(context, "    ", true);
+    os << "  },\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchmarkResult& result = results[i];
+        os << "    {\n" << std::format("      \"name\": \"{}\",\n", result.name);
+        lambdaWriteMetrics({
+                { "iterations", static_cast<double>(result.iterations) },
+                { "ns_per_iteration", result.nanosecondsPerIteration },
+                { "bytes_per_second", result.bytesPerSecond },
+            }, "      ", result.metrics.empty());
+        if (!result.metrics.empty())
+        {
+            os << "      \"metrics\": {\n";
+            lambdaWriteMetrics(result.metrics, "        ", true);
+            os << "      }\n";
+        }
+        os << (i + 1 < results.size() ? "    },\n" : "    }\n");
+    }
+    os << "  ]\n}\n";
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <chrono>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+struct BenchmarkResult
+{
+    std::string name;
+    size_t iterations = 0;
+    double nanosecondsPerIteration = 0;
+    double bytesPerSecond = 0;  // 0 if the benchmark doesn't process any data.
+    std::vector<std::pair<std::string, double>> metrics;  // Anything else measured, e.g. the latency percentiles.
+};
+
+
+// Runs `body` repeatedly for at least `minDuration`, after a warm up run.
+// `body` should return something depending on its work, so that the work is not optimized away.
+BenchmarkResult run_benchmark(std::string name, size_t bytesPerIteration, const std::function<size_t()>& body,
+    std::chrono::nanoseconds minDuration = std::chrono::milliseconds{ 500 });
+
+// The latencies at the usual percentiles, plus the mean and the max. `latencies` is sorted in place.
+std::vector<std::pair<std::string, double>> summarize_latencies(std::vector<double>& latencies);
+
+// The number of the latencies in each power of 2 range of nanoseconds, of the ranges that have any.
+std::vector<std::pair<std::string, double>> make_latency_histogram(const std::vector<double>& latencies);
+
+void print_benchmark_results(const std::vector<BenchmarkResult>& results);
+
+// `context` is written alongside the results, e.g. the options the benchmarks ran with.
+void write_benchmark_results_json(std::ostream& os, const std::vector<BenchmarkResult>& results, const std::vector<std::pair<std::string, double>>& context);
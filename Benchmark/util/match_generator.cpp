@@ -0,0 +1,91 @@
+#include "match_generator.h"
+
+#include <algorithm>
+#include <random>
+#include <unordered_set>
+
+#include "../../Typoon/utils/string.h"
+
+
+// The letters a trigger is made of, the first `fanOut` of them are used.
+constexpr std::wstring_view ENGLISH_LETTERS = L"etaoinshrdlcumwfgypbvkjxqz";
+constexpr std::wstring_view KOREAN_LETTERS = L"가나다라마바사아자차카타파하고노도로모보소오조초코토포호구누두루무부수우주추쿠투푸후";
+
+
+class WordGenerator
+{
+public:
+    explicit WordGenerator(const MatchSetOptions& options)
+        : mRandom(options.seed)
+        , mIsKorean(options.koreanRatio)
+        , mLength(std::max(1, options.triggerLength / 2), std::max(1, options.triggerLength + options.triggerLength / 2))
+        , mEnglishLetter(0, std::clamp<size_t>(static_cast<size_t>(options.fanOut), 1, ENGLISH_LETTERS.size()) - 1)
+        , mKoreanLetter(0, std::clamp<size_t>(static_cast<size_t>(options.fanOut), 1, KOREAN_LETTERS.size()) - 1)
+    {}
+
+    std::wstring Generate()
+    {
+        const bool isKorean = mIsKorean(mRandom);
+        std::wstring word(static_cast<size_t>(mLength(mRandom)), 0);
+        for (wchar_t& letter : word)
+        {
+            letter = isKorean ? KOREAN_LETTERS[mKoreanLetter(mRandom)] : ENGLISH_LETTERS[mEnglishLetter(mRandom)];
+        }
+        return word;
+    }
+
+    std::mt19937& GetRandom() { return mRandom; }
+
+private:
+    std::mt19937 mRandom;
+    std::bernoulli_distribution mIsKorean;
+    std::uniform_int_distribution<int> mLength;
+    std::uniform_int_distribution<size_t> mEnglishLetter;
+    std::uniform_int_distribution<size_t> mKoreanLetter;
+};
+
+
+GeneratedMatchSet generate_match_set(const MatchSetOptions& options)
+{
+    WordGenerator generator{ options };
+    GeneratedMatchSet matchSet;
+    std::unordered_set<std::wstring> triggers;
+
+    // Not every trigger can be different with a small fan-out, so give up after a while.
+    for (size_t attempt = 0; triggers.size() < options.matchCount && attempt < options.matchCount * 10; attempt++)
+    {
+        if (std::wstring trigger = generator.Generate();
+            triggers.insert(trigger).second)
+        {
+            matchSet.triggers.emplace_back(std::move(trigger));
+        }
+    }
+
+    matchSet.matchesString = "{\n    matches: [\n";
+    for (const std::wstring& trigger : matchSet.triggers)
+    {
+        const std::string u8Trigger = to_u8_string(trigger);
+        matchSet.matchesString += "        { trigger: '" + u8Trigger + "', replace: '" + u8Trigger + "!' },\n";
+    }
+    matchSet.matchesString += "    ]\n}\n";
+    return matchSet;
+}
+
+
+std::wstring generate_typing(const GeneratedMatchSet& matchSet, const MatchSetOptions& options, size_t keystrokeCount, double triggerRatio)
+{
+    MatchSetOptions typingOptions = options;
+    typingOptions.seed = options.seed + 1;
+    WordGenerator generator{ typingOptions };
+    std::bernoulli_distribution isTrigger{ matchSet.triggers.empty() ? 0.0 : triggerRatio };
+    std::uniform_int_distribution<size_t> trigger{ 0, std::max<size_t>(matchSet.triggers.size(), 1) - 1 };
+
+    std::wstring typing;
+    while (typing.size() < keystrokeCount)
+    {
+        typing += normalize_hangeul(isTrigger(generator.GetRandom()) ? matchSet.triggers[trigger(generator.GetRandom())] : generator.Generate());
+        typing += L' ';
+    }
+    typing.resize(keystrokeCount);
+    return typing;
+}
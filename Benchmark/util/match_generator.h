@@ -0,0 +1,28 @@
+#pragma once
+#include <string>
+#include <vector>
+
+
+struct MatchSetOptions
+{
+    size_t matchCount = 10000;
+    int fanOut = 8;  // The number of different letters at each position of the triggers.
+    int triggerLength = 6;  // The average length, in letters before normalization.
+    double koreanRatio = 0.3;  // Of the triggers and the words typed.
+    unsigned int seed = 0;
+};
+
+
+struct GeneratedMatchSet
+{
+    std::string matchesString;  // A match file with the matches below, in the format `TriggerTree::Reconstruct` takes.
+    std::vector<std::wstring> triggers;
+};
+
+
+// Random but the same for the same options.
+GeneratedMatchSet generate_match_set(const MatchSetOptions& options);
+
+// What a user would type with the match set, where about `triggerRatio` of the words are triggers.
+// Already normalized, so it can be typed letter by letter.
+std::wstring generate_typing(const GeneratedMatchSet& matchSet, const MatchSetOptions& options, size_t keystrokeCount, double triggerRatio = 0.2);
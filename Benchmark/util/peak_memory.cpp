@@ -0,0 +1,15 @@
+#include "peak_memory.h"
+
+#include <Windows.h>
+#include <Psapi.h>
+
+
+size_t get_peak_memory_usage()
+{
+    PROCESS_MEMORY_COUNTERS counters{ .cb = sizeof(counters) };
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    {
+        return 0;
+    }
+    return counters.PeakWorkingSetSize;
+}
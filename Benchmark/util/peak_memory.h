@@ -0,0 +1,6 @@
+#pragma once
+#include <cstddef>
+
+
+// The most memory the process has used so far, in bytes. 0 if it's unknown.
+size_t get_peak_memory_usage();
@@ -0,0 +1,224 @@
+#include <algorithm>
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../Typoon/utils/binary_log.h"
+#include "../Typoon/utils/log_rotation.h"
+
+
+constexpr std::string_view USAGE =
+    "Usage: LogDecoder <log file> [options]\n"
+    "  Prints the binary log written by Typoon as text, after the segments rotated out of it.\n"
+    "  The log file can also be a segment, either compressed (.tylz) or not.\n"
+    "  --min-level <level>  Skip the logs below it, one of DEBUG, INFO, WARNING, ERROR and FATAL. (default: DEBUG)\n"
+    "  --sites              Print the file and the line each log is from.\n"
+    "  --tail <count>       Print only the last logs, decompressing only the segments they're in.\n"
+    "  --output <file>      Write into the file instead of the standard output.\n";
+
+constexpr std::string_view LOG_LEVEL_NAMES[]{ "", "DEBUG", "INFO", "WARNING", "ERROR", "FATAL" };
+
+
+// Calls `onChunk` with the parts of the file that can be read on their own, from the last one to the first, until it returns false.
+bool for_each_log_chunk_backward(const std::filesystem::path& file, const std::function<bool(std::span<const std::byte> chunk)>& onChunk)
+{
+    if (file.extension() == ".tylz")
+    {
+        return read_compressed_log_backward(file, onChunk);
+    }
+
+    std::ifstream ifs{ file, std::ios::binary };
+    const std::vector<char> raw{ std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>() };
+    const auto data = std::as_bytes(std::span{ raw });
+    const std::vector<size_t> sessions = find_binary_log_sessions(data);
+    size_t chunkEnd = data.size();
+    for (const size_t session : sessions | std::views::reverse)
+    {
+        if (!onChunk(data.subspan(session, chunkEnd - session)))
+        {
+            break;
+        }
+        chunkEnd = session;
+    }
+    return !sessions.empty();
+}
+
+
+int main(int argc, char** argv)
+{
+    std::filesystem::path logFile;
+    std::filesystem::path outputFile;
+    LogLevel minLogLevel = ELogLevel::DEBUG;
+    bool doPrintSites = false;
+    size_t tailCount = std::numeric_limits<size_t>::max();
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string_view option = argv[i];
+        const std::string_view argument = i + 1 < argc ? argv[i + 1] : "";
+        bool isValid = true;
+        if (option == "--sites")
+        {
+            doPrintSites = true;
+            continue;
+        }
+        else if (option == "--min-level")
+        {
+            const auto* name = std::ranges::find(LOG_LEVEL_NAMES, argument);
+            minLogLevel = { static_cast<LogLevel::ELogLevel>(name - std::begin(LOG_LEVEL_NAMES)) };
+            isValid = !argument.empty() && name != std::end(LOG_LEVEL_NAMES);
+        }
+        else if (option == "--tail")
+        {
+            const auto [end, error] = std::from_chars(argument.data(), argument.data() + argument.size(), tailCount);
+            isValid = !argument.empty() && error == std::errc{} && end == argument.data() + argument.size();
+        }
+        else if (option == "--output")
+        {
+            outputFile = argument;
+            isValid = !outputFile.empty();
+        }
+        else if (!option.starts_with("--") && logFile.empty())
+        {
+            logFile = option;
+            continue;
+        }
+        else
+        {
+            isValid = false;
+        }
+
+        if (!isValid)
+        {
+            std::cerr << "Invalid option: " << option << ' ' << argument << "\n\n" << USAGE;
+            return 1;
+        }
+        i++;
+    }
+
+    if (logFile.empty())
+    {
+        std::cerr << USAGE;
+        return 1;
+    }
+
+    std::wofstream ofs;
+    if (!outputFile.empty())
+    {
+        ofs.open(outputFile);
+        if (!ofs)
+        {
+            std::cerr << "Failed to open " << outputFile.string() << '\n';
+            return 1;
+        }
+    }
+    std::wostream& output = outputFile.empty() ? std::wcout : ofs;
+    output.imbue(std::locale{ "" });
+
+    size_t brokenCount = 0;
+    // The lines of a file, from its last chunks until there are `maxLineCount` of them.
+    const auto lambdaDecodeFile = [&](const std::filesystem::path& file, size_t maxLineCount, std::vector<std::wstring>& lines)
+        {
+            std::vector<std::vector<std::wstring>> chunks;
+            size_t lineCount = 0;
+            const bool isValid = for_each_log_chunk_backward(file, [&](std::span<const std::byte> chunk)
+                {
+                    std::vector<std::wstring>& chunkLines = chunks.emplace_back();
+                    read_binary_log(chunk, [&](const BinaryLogEntry& entry)
+                        {
+                            if (entry.logLevel < minLogLevel)
+                            {
+                                return;
+                            }
+
+                            std::wstring& line = chunkLines.emplace_back();
+                            append_log_line_prefix(line, entry.time, entry.logLevel);
+                            if (doPrintSites)
+                            {
+                                const std::string_view sourceFile = entry.file.substr(std::min(entry.file.find_last_of("/\\") + 1, entry.file.size()));
+                                line.append(sourceFile.begin(), sourceFile.end());
+                                line.append(L":" + std::to_wstring(entry.line) + L" ");
+                            }
+                            if (!append_log_arguments(entry.arguments, line))
+                            {
+                                brokenCount++;
+                            }
+                            line.push_back(L'\n');
+                        });
+                    lineCount += chunkLines.size();
+                    return lineCount < maxLineCount;
+                });
+
+            for (std::vector<std::wstring>& chunkLines : chunks | std::views::reverse)
+            {
+                std::ranges::move(chunkLines, std::back_inserter(lines));
+            }
+            if (!isValid)
+            {
+                std::cerr << file.string() << " is corrupted or not a binary log.\n";
+            }
+            return isValid;
+        };
+
+    std::vector<std::filesystem::path> files = find_log_segments(logFile);
+    files.push_back(logFile);
+    bool isLogFileValid = true;
+    if (tailCount == std::numeric_limits<size_t>::max())
+    {
+        // A file at a time, to keep only one of them in memory.
+        for (const std::filesystem::path& file : files)
+        {
+            std::vector<std::wstring> lines;
+            isLogFileValid = lambdaDecodeFile(file, tailCount, lines);
+            for (const std::wstring& line : lines)
+            {
+                output << line;
+            }
+        }
+    }
+    else
+    {
+        // From the newest file, and stops once there are enough lines.
+        std::vector<std::vector<std::wstring>> fileLines;
+        size_t lineCount = 0;
+        for (const std::filesystem::path& file : files | std::views::reverse)
+        {
+            if (lineCount >= tailCount)
+            {
+                break;
+            }
+            std::vector<std::wstring>& lines = fileLines.emplace_back();
+            const bool isValid = lambdaDecodeFile(file, tailCount - lineCount, lines);
+            isLogFileValid = isLogFileValid && (isValid || file != logFile);
+            lineCount += lines.size();
+        }
+
+        size_t skipCount = lineCount > tailCount ? lineCount - tailCount : 0;
+        for (const std::vector<std::wstring>& lines : fileLines | std::views::reverse)
+        {
+            for (const std::wstring& line : lines | std::views::drop(std::min(skipCount, lines.size())))
+            {
+                output << line;
+            }
+            skipCount -= std::min(skipCount, lines.size());
+        }
+    }
+    output.flush();
+
+    if (!isLogFileValid)
+    {
+        return 1;
+    }
+    if (brokenCount > 0)
+    {
+        std::cerr << brokenCount << " logs had broken arguments.\n";
+    }
+    return 0;
+}
@@ -1,10 +1,18 @@
 ﻿#include "imm_simulator.h"
 
+#include "../utils/latency_probe.h"
 #include "../utils/logger.h"
 
 
 void ImmSimulator::AddLetter(wchar_t letter, bool doMulticast)
 {
+    const LatencyProbe probe{ ELatencyProbe::IMM_ADD_LETTER };
+    // The ones not multicast are from the replacements, not from the user.
+    if (doMulticast)
+    {
+        mark_input_start(probe.GetStart());
+    }
+
     InputMessage messages[MAX_INPUT_COUNT];
     int messageLength = 0;
     const auto lambdaAddMessage = [&messages, &messageLength](const InputMessage& message)
@@ -2,9 +2,12 @@
 
 #include <ranges>
 
+#include "../utils/latency_probe.h"
+
 
 void multicast_input(const InputMessage(&inputs)[MAX_INPUT_COUNT], int length, bool clearAllAgents)
 {
+    const LatencyProbe probe{ ELatencyProbe::MULTICAST_INPUT };
     for (auto& listener : input_listeners | std::views::values)
     {
         listener(inputs, length, clearAllAgents);
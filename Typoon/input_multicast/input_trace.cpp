@@ -0,0 +1,184 @@
+#include "input_trace.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+
+#include "../utils/logger.h"
+
+
+constexpr char INPUT_TRACE_MAGIC[4]{ 'T', 'Y', 'I', 'T' };
+// Bump whenever the layout of the records changes.
+constexpr unsigned int INPUT_TRACE_VERSION = 1;
+constexpr char INPUT_TRACE_LISTENER_NAME[] = "input_trace";
+
+/// A record is a flag byte, the time since the previous record as a LEB128 in microseconds, then the letters in 2 bytes each.
+/// The flag byte holds the number of the inputs, whether to clear all the agents, and whether each input is being composed.
+constexpr unsigned char LENGTH_MASK = 0b11;
+constexpr unsigned char CLEAR_ALL_AGENTS_FLAG = 1 << 2;
+constexpr int IS_BEING_COMPOSED_SHIFT = 3;
+static_assert(MAX_INPUT_COUNT <= LENGTH_MASK && IS_BEING_COMPOSED_SHIFT + MAX_INPUT_COUNT <= 8, "The flags should fit in a byte.");
+
+
+struct InputCapture
+{
+    std::ofstream ofs;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::microseconds lastTime{ 0 };
+};
+std::unique_ptr<InputCapture> input_capture;
+
+
+void write_input_trace_record(InputCapture& capture, const InputMessage(&inputs)[MAX_INPUT_COUNT], int length, bool clearAllAgents)
+{
+    // Not more than 1 + 10 + 2 * MAX_INPUT_COUNT bytes.
+    unsigned char record[16];
+    size_t size = 0;
+
+    auto flags = static_cast<unsigned char>(length | (clearAllAgents ? CLEAR_ALL_AGENTS_FLAG : 0));
+    for (int i = 0; i < length; i++)
+    {
+        flags |= static_cast<unsigned char>(inputs[i].isBeingComposed ? 1 << (IS_BEING_COMPOSED_SHIFT + i) : 0);
+    }
+    record[size++] = flags;
+
+    const auto time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - capture.start);
+    for (auto delta = static_cast<unsigned long long>(std::max(time - capture.lastTime, std::chrono::microseconds{ 0 }).count()); ; delta >>= 7)
+    {
+        if (delta < 0x80)
+        {
+            record[size++] = static_cast<unsigned char>(delta);
+            break;
+        }
+        record[size++] = static_cast<unsigned char>((delta & 0x7F) | 0x80);
+    }
+    capture.lastTime = time;
+
+    for (int i = 0; i < length; i++)
+    {
+        const auto letter = static_cast<unsigned short>(inputs[i].letter);
+        record[size++] = static_cast<unsigned char>(letter & 0xFF);
+        record[size++] = static_cast<unsigned char>(letter >> 8);
+    }
+
+    capture.ofs.write(reinterpret_cast<const char*>(record), static_cast<std::streamsize>(size));
+}
+
+
+bool start_input_capture(const std::filesystem::path& traceFile)
+{
+    stop_input_capture();
+
+    auto capture = std::make_unique<InputCapture>();
+    capture->ofs.open(traceFile, std::ios::binary | std::ios::trunc);
+    capture->ofs.write(INPUT_TRACE_MAGIC, sizeof(INPUT_TRACE_MAGIC));
+    capture->ofs.write(reinterpret_cast<const char*>(&INPUT_TRACE_VERSION), sizeof(INPUT_TRACE_VERSION));
+    if (!capture->ofs)
+    {
+        logger.Log(ELogLevel::ERROR, "Failed to open the input trace file:", traceFile);
+        return false;
+    }
+    capture->start = std::chrono::steady_clock::now();
+    input_capture = std::move(capture);
+
+    input_listeners.emplace_back(INPUT_TRACE_LISTENER_NAME,
+        [](const InputMessage(&inputs)[MAX_INPUT_COUNT], int length, bool clearAllAgents)
+        {
+            if (input_capture)
+            {
+                write_input_trace_record(*input_capture, inputs, length, clearAllAgents);
+            }
+        });
+
+    logger.Log(ELogLevel::WARNING, "Capturing every input into:", traceFile);
+    return true;
+}
+
+
+void stop_input_capture()
+{
+    if (!input_capture)
+    {
+        return;
+    }
+
+    std::erase_if(input_listeners, [](const std::pair<std::string, InputListener>& pair) { return pair.first == INPUT_TRACE_LISTENER_NAME; });
+    input_capture->ofs.flush();
+    if (!input_capture->ofs)
+    {
+        logger.Log(ELogLevel::WARNING, "Failed to write the input trace.");
+    }
+    input_capture.reset();
+    logger.Log(ELogLevel::INFO, "Input capture stopped.");
+}
+
+
+bool is_capturing_input()
+{
+    return input_capture != nullptr;
+}
+
+
+bool read_input_trace(const std::filesystem::path& traceFile, std::vector<InputTraceEvent>& events)
+{
+    std::ifstream ifs{ traceFile, std::ios::binary };
+    const std::vector<unsigned char> data{ std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>() };
+
+    unsigned int version = 0;
+    if (data.size() < sizeof(INPUT_TRACE_MAGIC) + sizeof(version) || std::memcmp(data.data(), INPUT_TRACE_MAGIC, sizeof(INPUT_TRACE_MAGIC)) != 0)
+    {
+        return false;
+    }
+    std::memcpy(&version, data.data() + sizeof(INPUT_TRACE_MAGIC), sizeof(version));
+    if (version != INPUT_TRACE_VERSION)
+    {
+        return false;
+    }
+
+    events.clear();
+    std::chrono::microseconds time{ 0 };
+    for (size_t cursor = sizeof(INPUT_TRACE_MAGIC) + sizeof(version); cursor < data.size();)
+    {
+        InputTraceEvent& event = events.emplace_back();
+        const unsigned char flags = data[cursor++];
+        event.length = flags & LENGTH_MASK;
+        event.clearAllAgents = (flags & CLEAR_ALL_AGENTS_FLAG) != 0;
+        if (event.length > MAX_INPUT_COUNT)
+        {
+            return false;
+        }
+
+        unsigned long long delta = 0;
+        for (int shift = 0; ; shift += 7)
+        {
+            if (cursor >= data.size() || shift >= 64)
+            {
+                return false;
+            }
+            const unsigned char byte = data[cursor++];
+            delta |= static_cast<unsigned long long>(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+            {
+                break;
+            }
+        }
+        time += std::chrono::microseconds{ static_cast<std::chrono::microseconds::rep>(delta) };
+        event.time = time;
+
+        if (cursor + static_cast<size_t>(event.length) * 2 > data.size())
+        {
+            return false;
+        }
+        for (int i = 0; i < event.length; i++)
+        {
+            event.inputs[i] = {
+                .letter = static_cast<wchar_t>(data[cursor] | data[cursor + 1] << 8),
+                .isBeingComposed = (flags & 1 << (IS_BEING_COMPOSED_SHIFT + i)) != 0,
+            };
+            cursor += 2;
+        }
+    }
+    return true;
+}
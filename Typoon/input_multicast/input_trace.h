@@ -0,0 +1,27 @@
+#pragma once
+#include <chrono>
+#include <filesystem>
+#include <vector>
+
+#include "input_multicast.h"
+
+
+// A recording of the inputs multicast, so that a real workload can be replayed later without the user.
+// NOTE: Everything typed is recorded as-is, passwords included. Only capture on purpose.
+
+struct InputTraceEvent
+{
+    std::chrono::microseconds time{ 0 };  // Since the capture started.
+    InputMessage inputs[MAX_INPUT_COUNT]{};
+    int length = 0;
+    bool clearAllAgents = false;
+};
+
+
+// Listens to `input_listeners`, so the same thread restriction applies.
+bool start_input_capture(const std::filesystem::path& traceFile);
+void stop_input_capture();
+bool is_capturing_input();
+
+// Returns false if the file is not a valid trace, then `events` is left unspecified.
+bool read_input_trace(const std::filesystem::path& traceFile, std::vector<InputTraceEvent>& events);
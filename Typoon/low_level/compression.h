@@ -0,0 +1,10 @@
+#pragma once
+#include <cstddef>
+#include <span>
+#include <vector>
+
+
+// Lossless compression with whatever the platform provides. Both return false on failure.
+bool compress_bytes(std::span<const std::byte> data, std::vector<std::byte>& compressed);
+// `rawSize` is the size of the data before it was compressed.
+bool decompress_bytes(std::span<const std::byte> compressed, size_t rawSize, std::vector<std::byte>& data);
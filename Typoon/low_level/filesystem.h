@@ -9,3 +9,8 @@ const std::filesystem::path& get_config_file_path();
 std::filesystem::path get_log_file_path();
 
 std::filesystem::path get_crash_file_path();
+
+std::filesystem::path get_latency_report_file_path();
+
+// Returns an empty path if caching is not available.
+const std::filesystem::path& get_cache_directory_path();
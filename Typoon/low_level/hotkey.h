@@ -139,6 +139,7 @@ enum class [[nodiscard]] EHotKeyType
 {
     TOGGLE_ON_OFF,
     GET_PROGRAM_NAME,
+    DUMP_LATENCY_REPORT,
 };
 
 
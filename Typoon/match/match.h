@@ -5,7 +5,7 @@
 
 struct Match
 {
-    enum class EUppercaseStyle
+    enum class EUppercaseStyle : unsigned char
     {
         FIRST_LETTER,
         WORDS,
@@ -23,4 +23,6 @@ struct Match
     bool doNeedFullComposite;
     bool doKeepComposite;
     bool isKorEngInsensitive;
+
+    bool operator==(const Match& other) const = default;
 };
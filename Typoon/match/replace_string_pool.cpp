@@ -0,0 +1,227 @@
+#include "replace_string_pool.h"
+
+#include <algorithm>
+
+#include "../utils/logger.h"
+
+
+ReplaceStringPool::ReplaceStringPool(bool doShareSubstrings)
+    : mDoShareSubstrings(doShareSubstrings)
+{
+    Clear();
+}
+
+
+int ReplaceStringPool::Add(std::wstring_view str)
+{
+    mStatistics.addCount++;
+    mStatistics.addedLength += str.size();
+    if (str.empty())
+    {
+        return 0;
+    }
+
+    const size_t hash = std::hash<std::wstring_view>{}(str);
+    const auto [first, last] = mIndicesByHash.equal_range(hash);
+    for (auto it = first; it != last; ++it)
+    {
+        if (std::wstring_view{ mStrings }.substr(it->second, str.size()) == str)
+        {
+            mStatistics.exactMatchCount++;
+            return it->second;
+        }
+    }
+
+    int index = findSubstring(str);
+    if (index >= 0)
+    {
+        mStatistics.substringMatchCount++;
+    }
+    else
+    {
+        index = static_cast<int>(mStrings.size());
+        mStrings.append(str);
+        if (mDoShareSubstrings && !mIsSubstringIndexReleased)
+        {
+            for (int i = index; i < static_cast<int>(mStrings.size()); i++)
+            {
+                extendAutomaton(mStrings[i], i);
+            }
+        }
+    }
+
+    // Even if found as a substring, so that the same string is found faster next time.
+    mIndicesByHash.emplace(hash, index);
+    return index;
+}
+
+
+void ReplaceStringPool::ReleaseSubstringIndex()
+{
+    mIsSubstringIndexReleased = true;
+    // Swapped to free the memory, which `clear` keeps.
+    std::vector<AutomatonState>{}.swap(mAutomatonStates);
+    std::vector<AutomatonTransition>{}.swap(mAutomatonTransitions);
+    std::vector<int>{}.swap(mTransitionSlots);
+    mLastAutomatonState = 0;
+}
+
+
+void ReplaceStringPool::Clear()
+{
+    mStrings.clear();
+    mIndicesByHash.clear();
+    mAutomatonStates.clear();
+    mAutomatonTransitions.clear();
+    mTransitionSlots.clear();
+    mIsSubstringIndexReleased = false;
+    if (mDoShareSubstrings)
+    {
+        mAutomatonStates.emplace_back();  // The initial state, the empty string.
+    }
+    mLastAutomatonState = 0;
+    mStatistics = {};
+}
+
+
+void ReplaceStringPool::LogStatistics() const
+{
+    const size_t savedLength = mStatistics.addedLength - std::min(mStatistics.addedLength, mStrings.size());
+    logger.Log(ELogLevel::INFO, "Replace string pool - added:", mStatistics.addCount, "exact matches:", mStatistics.exactMatchCount,
+        "substring matches:", mStatistics.substringMatchCount, "length:", mStrings.size(), "saved length:", savedLength,
+        "automaton states:", mAutomatonStates.size(), "automaton transitions:", mAutomatonTransitions.size());
+}
+
+
+int ReplaceStringPool::findSubstring(std::wstring_view str) const
+{
+    if (!mDoShareSubstrings || mIsSubstringIndexReleased)
+    {
+        return -1;
+    }
+
+    int state = 0;
+    for (const wchar_t letter : str)
+    {
+        const int transition = findTransition(state, letter);
+        if (transition < 0)
+        {
+            return -1;
+        }
+        state = mAutomatonTransitions[transition].target;
+    }
+    return mAutomatonStates[state].firstEndIndex - static_cast<int>(str.size()) + 1;
+}
+
+
+void ReplaceStringPool::extendAutomaton(wchar_t letter, int index)
+{
+    const int current = static_cast<int>(mAutomatonStates.size());
+    mAutomatonStates.emplace_back(AutomatonState{ .length = mAutomatonStates[mLastAutomatonState].length + 1, .firstEndIndex = index });
+
+    int state = mLastAutomatonState;
+    for (; state >= 0 && findTransition(state, letter) < 0; state = mAutomatonStates[state].link)
+    {
+        addTransition(state, letter, current);
+    }
+    mLastAutomatonState = current;
+
+    if (state < 0)
+    {
+        mAutomatonStates[current].link = 0;
+        return;
+    }
+
+    const int next = mAutomatonTransitions[findTransition(state, letter)].target;
+    if (mAutomatonStates[state].length + 1 == mAutomatonStates[next].length)
+    {
+        mAutomatonStates[current].link = next;
+        return;
+    }
+
+    // `next` also stands for longer substrings which don't end here, split the shorter ones into a clone.
+    const int clone = static_cast<int>(mAutomatonStates.size());
+    mAutomatonStates.emplace_back(AutomatonState{
+        .length = mAutomatonStates[state].length + 1,
+        .link = mAutomatonStates[next].link,
+        .firstEndIndex = mAutomatonStates[next].firstEndIndex,
+    });
+    for (int transition = mAutomatonStates[next].firstTransition; transition >= 0; transition = mAutomatonTransitions[transition].nextTransition)
+    {
+        addTransition(clone, mAutomatonTransitions[transition].letter, mAutomatonTransitions[transition].target);
+    }
+    for (; state >= 0; state = mAutomatonStates[state].link)
+    {
+        const int transition = findTransition(state, letter);
+        if (transition < 0 || mAutomatonTransitions[transition].target != next)
+        {
+            break;
+        }
+        mAutomatonTransitions[transition].target = clone;
+    }
+    mAutomatonStates[next].link = clone;
+    mAutomatonStates[current].link = clone;
+}
+
+
+size_t hash_transition(int state, wchar_t letter)
+{
+    const unsigned long long hash = ((static_cast<unsigned long long>(state) << 32) | static_cast<unsigned int>(letter)) * 0x9E3779B97F4A7C15ULL;
+    return static_cast<size_t>(hash ^ (hash >> 32));
+}
+
+
+int ReplaceStringPool::findTransition(int state, wchar_t letter) const
+{
+    if (mTransitionSlots.empty())
+    {
+        return -1;
+    }
+
+    const size_t mask = mTransitionSlots.size() - 1;
+    for (size_t slot = hash_transition(state, letter) & mask; ; slot = (slot + 1) & mask)
+    {
+        const int transition = mTransitionSlots[slot];
+        if (transition < 0 || (mAutomatonTransitions[transition].state == state && mAutomatonTransitions[transition].letter == letter))
+        {
+            return transition;
+        }
+    }
+}
+
+
+void ReplaceStringPool::addTransition(int state, wchar_t letter, int target)
+{
+    const int transition = static_cast<int>(mAutomatonTransitions.size());
+    mAutomatonTransitions.emplace_back(AutomatonTransition{
+        .state = state,
+        .target = target,
+        .nextTransition = mAutomatonStates[state].firstTransition,
+        .letter = letter,
+    });
+    mAutomatonStates[state].firstTransition = transition;
+
+    // Kept at most half full, so that the probing stays short.
+    if (mAutomatonTransitions.size() * 2 > mTransitionSlots.size())
+    {
+        mTransitionSlots.assign(std::max<size_t>(mTransitionSlots.size() * 2, 64), -1);
+        for (int i = 0; i < static_cast<int>(mAutomatonTransitions.size()); i++)
+        {
+            insertTransitionSlot(i);
+        }
+        return;
+    }
+    insertTransitionSlot(transition);
+}
+
+
+void ReplaceStringPool::insertTransitionSlot(int transition)
+{
+    const size_t mask = mTransitionSlots.size() - 1;
+    size_t slot = hash_transition(mAutomatonTransitions[transition].state, mAutomatonTransitions[transition].letter) & mask;
+    while (mTransitionSlots[slot] >= 0)
+    {
+        slot = (slot + 1) & mask;
+    }
+    mTransitionSlots[slot] = transition;
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+// All the replace strings of a tree in a single buffer, each of them referred to by the index and the length.
+// A string is stored only once. If `doShareSubstrings`, a string which is a part of the ones already stored is not stored either,
+// until `ReleaseSubstringIndex` is called.
+// The strings are never removed until cleared.
+class ReplaceStringPool
+{
+public:
+    explicit ReplaceStringPool(bool doShareSubstrings = false);
+
+    // Returns the index of `str` in the buffer.
+    [[nodiscard]] int Add(std::wstring_view str);
+    // Frees the suffix automaton, which is much larger than the strings. Only the exact duplicates are shared after it until cleared.
+    void ReleaseSubstringIndex();
+    void Clear();
+    void LogStatistics() const;
+
+    [[nodiscard]] const std::wstring& GetStrings() const { return mStrings; }
+    [[nodiscard]] size_t GetAutomatonStateCount() const { return mAutomatonStates.size(); }
+
+private:
+    // Returns the index of `str` in the buffer if it's a substring of it, -1 otherwise.
+    [[nodiscard]] int findSubstring(std::wstring_view str) const;
+    // Extends the suffix automaton with the letter appended at `index`.
+    void extendAutomaton(wchar_t letter, int index);
+    // Returns the index of the transition in `mAutomatonTransitions`, -1 if there's none.
+    [[nodiscard]] int findTransition(int state, wchar_t letter) const;
+    void addTransition(int state, wchar_t letter, int target);
+    void insertTransitionSlot(int transition);
+
+
+private:
+    std::wstring mStrings;
+    std::unordered_multimap<size_t, int> mIndicesByHash;  // Of the strings added as a whole.
+
+    /// A suffix automaton of `mStrings`, which accepts every substring of it.
+    /// It's built as the strings are appended, so finding a substring takes only the time linear to its length.
+    struct AutomatonState
+    {
+        int length = 0;  // The length of the longest substring ending here.
+        int link = -1;  // The suffix link.
+        int firstEndIndex = -1;  // Where the substrings ending here first end in the buffer.
+        int firstTransition = -1;  // The transitions of a state are linked, only to be copied when the state is cloned.
+    };
+    struct AutomatonTransition
+    {
+        int state = 0;
+        int target = 0;
+        int nextTransition = -1;
+        wchar_t letter = 0;
+    };
+    bool mDoShareSubstrings = false;
+    bool mIsSubstringIndexReleased = false;
+    std::vector<AutomatonState> mAutomatonStates;
+    /// All the transitions in a single array instead of one per state, looked up by the state and the letter through an open addressing table.
+    std::vector<AutomatonTransition> mAutomatonTransitions;
+    std::vector<int> mTransitionSlots;  // Indices of `mAutomatonTransitions`, -1 if empty. The size is a power of 2.
+    int mLastAutomatonState = 0;
+
+    struct Statistics
+    {
+        size_t addCount = 0;
+        size_t addedLength = 0;
+        size_t exactMatchCount = 0;
+        size_t substringMatchCount = 0;
+    } mStatistics;
+};
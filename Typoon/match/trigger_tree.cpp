@@ -1,7 +1,12 @@
 ﻿#include "trigger_tree.h"
 
-#include <cwctype>
+#include <algorithm>
+#include <bit>
+#include <cwchar>
+#include <format>
 #include <map>
+#include <ranges>
+#include <span>
 
 #include "../imm/imm_simulator.h"
 #include "../low_level/clipboard.h"
@@ -11,15 +16,68 @@
 #include "../low_level/tray_icon.h"
 #include "../parse/parse_match.h"
 #include "../utils/config.h"
+#include "../utils/latency_probe.h"
 #include "../utils/logger.h"
 #include "../utils/string.h"
+#include "trigger_tree_builder.h"
+#include "trigger_tree_cache.h"
+
+#if WCHAR_MAX == 0xFFFF && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define CAN_FIND_LETTER_WITH_SSE2
+#include <immintrin.h>
+#endif
+
+
+// The nodes with more children than this are binary searched instead.
+constexpr int MAX_SCANNED_CHILD_COUNT = 64;
+
+
+// Returns the index of the first `letter` in `letters`, or the size of it if there's none.
+// Compares 16 or 8 letters at once where it can.
+size_t find_letter(std::span<const wchar_t> letters, wchar_t letter)
+{
+    size_t index = 0;
+#ifdef CAN_FIND_LETTER_WITH_SSE2
+#ifdef __AVX2__
+    const __m256i target256 = _mm256_set1_epi16(static_cast<short>(letter));
+    for (; index + 16 <= letters.size(); index += 16)
+    {
+        const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(letters.data() + index));
+        if (const auto mask = static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_cmpeq_epi16(chunk, target256)));
+            mask != 0)
+        {
+            // 2 bits for each letter.
+            return index + std::countr_zero(mask) / 2;
+        }
+    }
+#endif
+    const __m128i target128 = _mm_set1_epi16(static_cast<short>(letter));
+    for (; index + 8 <= letters.size(); index += 8)
+    {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(letters.data() + index));
+        if (const auto mask = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi16(chunk, target128)));
+            mask != 0)
+        {
+            return index + std::countr_zero(mask) / 2;
+        }
+    }
+#endif
+    for (; index < letters.size(); index++)
+    {
+        if (letters[index] == letter)
+        {
+            return index;
+        }
+    }
+    return letters.size();
+}
 
 
 bool Letter::operator==(wchar_t ch) const
 {
     if (letter == NON_WORD_LETTER)
     {
-        return !std::iswalnum(ch);
+        return !is_alnum(ch);
     }
 
     if (isCaseSensitive || !is_cased_alpha(ch))
@@ -27,7 +85,7 @@ bool Letter::operator==(wchar_t ch) const
         return letter == ch;
     }
 
-    return std::towlower(letter) == std::towlower(ch);
+    return fold_case(letter) == fold_case(ch);
 }
 
 
@@ -40,7 +98,7 @@ bool Letter::operator==(const Letter& other) const
 
     // The letters are not strictly the same.
     if (!isCaseSensitive && !other.isCaseSensitive &&  // If either is case sensitive, we can't perform case insensitive comparison.
-        std::towlower(letter) == std::towlower(other.letter))
+        fold_case(letter) == fold_case(other.letter))
     {
         return true;
     }
@@ -49,22 +107,85 @@ bool Letter::operator==(const Letter& other) const
 }
 
 
-// NOTE: We don't need partial ordering, since we're already saying that case insensitive and same-if-lowered `Letter`s are equal.
+// NOTE: We don't need partial ordering, since we're already saying that case insensitive and same-if-folded `Letter`s are equal.
 std::strong_ordering Letter::operator<=>(const Letter& other) const
 {
-    if (std::towlower(letter) == std::towlower(other.letter))
+    if (const std::strong_ordering comp = fold_case(letter) <=> fold_case(other.letter);
+        comp != std::strong_ordering::equal)
     {
-        // Case sensitive ones come first.
-        return other.isCaseSensitive <=> isCaseSensitive;
+        return comp;
     }
 
-    if (const std::strong_ordering comp = letter <=> other.letter;
+    // Case sensitive ones come first.
+    if (const std::strong_ordering comp = other.isCaseSensitive <=> isCaseSensitive;
         comp != std::strong_ordering::equal)
     {
         return comp;
     }
 
-    return isCaseSensitive <=> other.isCaseSensitive;
+    // Case sensitive letters are different if they're not strictly the same, while case insensitive ones are the same.
+    return isCaseSensitive ? letter <=> other.letter : std::strong_ordering::equal;
+}
+
+
+void Node::SetLetter(const Letter& newLetter)
+{
+    letter = newLetter.letter;
+    flags &= ~(CASE_SENSITIVE | NEED_FULL_COMPOSITE);
+    flags |= (newLetter.isCaseSensitive ? CASE_SENSITIVE : 0) | (newLetter.doNeedFullComposite ? NEED_FULL_COMPOSITE : 0);
+}
+
+
+void Node::SetEnding(int endingIndex)
+{
+    flags |= ENDING;
+    link = static_cast<unsigned int>(endingIndex);
+}
+
+
+bool Node::SetChildren(int nodeIndex, ChildRange children)
+{
+    const auto [childBegin, childEnd] = children;
+    if (childBegin == childEnd)
+    {
+        link = 0;
+        return true;
+    }
+
+    // The children always come after the node in level-order.
+    const auto offset = static_cast<unsigned int>(childBegin - nodeIndex);
+    const auto length = static_cast<unsigned int>(childEnd - childBegin);
+    if (offset >= FAR_CHILDREN || length > 0xFFFF)
+    {
+        link = FAR_CHILDREN;
+        return false;
+    }
+    link = offset | (length << 16);
+    return true;
+}
+
+
+void StrokeBuffer::Reset(size_t capacity)
+{
+    mBuffer.assign(capacity * 2, 0);
+    mCapacity = capacity;
+    mHead = 0;
+}
+
+
+void StrokeBuffer::Push(wchar_t letter)
+{
+    // Overwrites the oldest letter, which is at the front of the view.
+    mBuffer[mHead] = letter;
+    mBuffer[mHead + mCapacity] = letter;
+    mHead = (mHead + 1) % mCapacity;
+}
+
+
+void StrokeBuffer::Pop()
+{
+    // The letter coming in at the front is a stale one, same as shifting the letters to the right.
+    mHead = (mHead + mCapacity - 1) % mCapacity;
 }
 
 
@@ -72,6 +193,7 @@ TriggerTree::TriggerTree(std::filesystem::path matchFile, std::vector<std::files
     : mMatchFile(std::move(matchFile))
     , mIncludes(std::move(includes))
     , mExcludes(std::move(excludes))
+    , mBuilder(std::make_unique<TriggerTreeBuilder>())
 {}
 
 
@@ -87,31 +209,20 @@ TriggerTree::~TriggerTree()
 
 void TriggerTree::Reconstruct(std::string_view matchesString, std::function<void()> onFinish)
 {
-    struct EndingMetaData
-    {
-        std::wstring replace;
-        Ending tempEnding;
-    };
+    reconstruct(matchesString, std::move(onFinish), false);
+}
 
-    struct TempNode
-    {
-        /// These are used for recording duplicates
-        const Match* match = nullptr;
-        const std::wstring* originalTrigger = nullptr;
-        std::wstring trigger;
 
-        /// This is used in the second iteration
-        int parentIndex = -1;
-        const Letter* letter = nullptr;
-        unsigned int height = 0;
+void TriggerTree::ReconstructIncrementally(std::string_view matchesString, std::function<void()> onFinish)
+{
+    reconstruct(matchesString, std::move(onFinish), true);
+}
 
-        std::map<Letter, TempNode> children{};  // empty == ending
-        EndingMetaData endingMetaData{};  // only valid if children is empty
-    };
 
+void TriggerTree::reconstruct(std::string_view matchesString, std::function<void()> onFinish, bool isIncremental)
+{
     HaltConstruction();
-    mIsTriggerTreeOutdated.store(true);
-    mIsConstructingTriggerTree.store(true);
+    mConstruction.Start();
 
     logger.Log(ELogLevel::INFO, mMatchFile, "Trigger tree construction started");
 
@@ -119,306 +230,127 @@ void TriggerTree::Reconstruct(std::string_view matchesString, std::function<void
         [this,
         matchesString = std::string{ matchesString.begin(), matchesString.end() },
         onFinish = std::move(onFinish),
+        isIncremental,
         didCallOnFinish = false](const std::stop_token& stopToken) mutable
     {
         #define STOP if (stopToken.stop_requested()) { if (onFinish && !didCallOnFinish) { didCallOnFinish = true; onFinish(); } return; }
 
-        STOP
-        std::vector<MatchForParse> matchesParsed;
-        if (matchesString.empty())
-        {
-            auto&& [matches, files] = parse_matches(mMatchFile, mIncludes, mExcludes);
-            matchesParsed = std::move(matches);
-            for (const std::filesystem::path& file : mImportedFiles)
-            {
-                std::erase(trigger_trees_by_match_file.at(file), this);
-            }
-            mImportedFiles = std::move(files);
-            for (const std::filesystem::path& file : mImportedFiles)
+        const auto lambdaFinishConstruction = [this, &onFinish, &didCallOnFinish](std::shared_ptr<CompiledTriggerTree> compiledTree)
             {
-                trigger_trees_by_match_file[file].emplace_back(this);
-            }
-        }
-        else
-        {
-            matchesParsed = parse_matches(std::string_view{ matchesString });
-        }
-        STOP
-        std::vector<Match> matches;
-        matches.reserve(matchesParsed.size());
-        std::ranges::transform(matchesParsed, std::back_inserter(matches), [](const MatchForParse& match) { return match; });
-        STOP
-        std::ranges::filter_view matchesFiltered{ matches, [](const Match& match)
-            {
-                return !match.triggers.empty() && (!match.replace.empty() || !match.replaceImage.empty() || !match.replaceCommand.empty());
-            }
-        };
-        // TODO: Warn about empty triggers or replaces
+                compiledTree->BuildLookupTables();
+                logger.Log(ELogLevel::INFO, mMatchFile, "Trigger tree layout -", compiledTree->GetLayoutReport());
+                // The input thread moves on to the new tree on the next input.
+                mCompiledTree.store(std::move(compiledTree));
 
-        /// First iteration. Construct the tree, preprocessing the data to be easy to use.
-        TempNode root;
-        std::vector<std::pair<const Match*, const std::wstring*>> triggersOverwritten;
-        for (const Match& match : matchesFiltered)
-        {
-            const auto& [originalTriggers, originalReplace, replaceImage, replaceCommand,
-                isCaseSensitive, isWord, doPropagateCase, uppercaseStyle, 
-                doNeedFullComposite, doKeepComposite, isKorEngInsensitive] = match;
-
-            std::vector<std::wstring> triggers;
-            if (isKorEngInsensitive)
-            {
-                triggers.reserve(originalTriggers.size() * 2);
-                for (const std::wstring& originalTrigger : originalTriggers)
+                mConstruction.Finish();
+                if (onFinish && !didCallOnFinish)
                 {
-                    // A trigger could be mixed with Korean and English letters.
-                    triggers.emplace_back(combine_hangeul(alphabet_to_hangeul(originalTrigger)));
-                    triggers.emplace_back(hangeul_to_alphabet(normalize_hangeul(originalTrigger), false));
+                    didCallOnFinish = true;
+                    onFinish();
                 }
-            }
-            else
-            {
-                // A copy that could be avoided, but I think it's OK because normally there won't be many triggers,
-                // and each of them won't be too long.
-                triggers = originalTriggers;
-            }
-
-            std::wstring replaceStr{ originalReplace };
-            if (isWord)
-            {
-                replaceStr.push_back(Letter::LAST_INPUT_LETTER);
-            }
-
-            unsigned int cursorMoveCount = 0;
-            const std::wstring& cursorPlaceholder = get_config().cursorPlaceholder;
-            if (const size_t cursorIndex = originalReplace.find(cursorPlaceholder);
-                cursorIndex != std::wstring::npos)
-            {
-                replaceStr.erase(cursorIndex, cursorPlaceholder.size());
-                cursorMoveCount = static_cast<unsigned int>(replaceStr.size() - cursorIndex);
-            }
 
-            const std::wstring_view replace = replaceStr;
-
-            const Ending::EReplaceType replaceType =
-                !replaceImage.empty() ? Ending::EReplaceType::IMAGE :
-                !replaceCommand.empty() ? Ending::EReplaceType::COMMAND :
-                Ending::EReplaceType::TEXT;
-            const Ending endingBase{
-                .type = replaceType,
-                .cursorMoveCount = cursorMoveCount,
-                // TODO: Abstract the extra conditions of the options and warn the user if ignored
-                .propagateCase = doPropagateCase && !isCaseSensitive && replaceType == Ending::EReplaceType::TEXT,
-                .uppercaseStyle = uppercaseStyle,
-                .keepComposite = doKeepComposite && is_korean(replace.back()) && replaceType == Ending::EReplaceType::TEXT,
+                logger.Log(ELogLevel::INFO, mMatchFile, "Trigger tree construction finished");
             };
 
-            const EndingMetaData endingMetaDataBase{
-                .replace =
-                    replaceType == Ending::EReplaceType::IMAGE ? replaceImage.generic_wstring() :
-                    replaceType == Ending::EReplaceType::COMMAND ? replaceCommand :
-                    std::wstring{ replace },
-            };
-
-            for (const auto& originalTrigger : triggers)
-            {
-                std::wstring triggerStr{ originalTrigger };
-
-                if (isWord)
-                {
-                    triggerStr.push_back(Letter::NON_WORD_LETTER);
-                }
-
-                const std::wstring_view trigger = triggerStr;
-
-                TempNode* node = &root;
-
-                bool isTriggerOverwritten = false;
-                // Make a node for each letter except the last one, that will be an 'ending node'.
-                for (auto triggerIt = trigger.begin(); triggerIt != trigger.end() - 1; ++triggerIt)
-                {
-                    const wchar_t ch = *triggerIt;
-                    auto [it, isNew] = node->children.try_emplace(
-                        Letter{
-                            .letter = ch,
-                            .isCaseSensitive = isCaseSensitive && is_cased_alpha(ch),
-                            .doNeedFullComposite = false
-                        },
-                        TempNode{
-                            .match = &match,
-                            .originalTrigger = &originalTrigger,
-                            .trigger = std::wstring{ trigger }
-                        });
-                    // Same case with the last letter overwriting, but in a reverse order.
-                    // The letters from here are not reachable anyway, so discard them altogether.
-                    if (!isNew && it->second.children.empty())
-                    {
-                        triggersOverwritten.emplace_back(&match, &originalTrigger);
-                        isTriggerOverwritten = true;
-                        break;
-                    }
-                    node = &it->second;
-                    STOP
-                }
-                if (isTriggerOverwritten)
-                {
-                    continue;
-                }
-
-                // The 'ending node'
-                const wchar_t triggerLastLetter = trigger.back();
-                auto backspaceCount = static_cast<unsigned int>(trigger.size());
-                const bool isTriggerLastLetterKorean = is_korean(triggerLastLetter);
-                // If the last letter is Korean, it's probably composed with more than 2 letters.
-                // The backspace count should be adjusted accordingly.
-                if (isTriggerLastLetterKorean)
-                {
-                    backspaceCount += static_cast<int>(normalize_hangeul(std::wstring_view{ &triggerLastLetter, 1 }).size()) - 1;
-                }
-                STOP
-
-                // Since finding a match resets all the agents, we cannot advance further anyway. Therefore overwriting is fine.
-                const bool needFullComposite = doNeedFullComposite && isTriggerLastLetterKorean && !isWord && !isKorEngInsensitive;
-                Letter letter{
-                    .letter = triggerLastLetter,
-                    .isCaseSensitive = isCaseSensitive && is_cased_alpha(triggerLastLetter) && !isKorEngInsensitive,
-                    .doNeedFullComposite = needFullComposite
-                };
-                if (node->children.contains(letter))
-                {
-                    TempNode& duplicate = node->children.at(letter);
-                    if (duplicate.children.empty())
-                    {
-                        // If there is already an ending node, keep the existing one.
-                        triggersOverwritten.emplace_back(&match, &originalTrigger);
-                        continue;
-                    }
-
-                    // Its children will be non-reachable, mark them as overwritten.
-                    std::queue<TempNode*> nodes;
-                    nodes.push(&duplicate);
-                    while (!nodes.empty())
-                    {
-                        TempNode* childNode = nodes.front();
-                        nodes.pop();
-                        if (childNode->children.empty())
-                        {
-                            triggersOverwritten.emplace_back(childNode->match, childNode->originalTrigger);
-                        }
-                        else
-                        {
-                            for (TempNode& child : childNode->children | std::views::values)
-                            {
-                                nodes.push(&child);
-                                STOP
-                            }
-                        }
-                        STOP
-                    }
-                }
-
-                // TODO: Abstract the extra conditions of the options and warn the user if ignored
-                Ending ending = endingBase;
-                ending.backspaceCount = backspaceCount;
-                ending.propagateCase &= std::ranges::any_of(trigger, [](wchar_t c) { return is_cased_alpha(c); });
-                ending.keepComposite &= !needFullComposite && cursorMoveCount == 0 && (trigger.size() > 1 || triggerLastLetter != replace.back());
-
-                EndingMetaData endingMetaData = endingMetaDataBase;
-                endingMetaData.tempEnding = ending;
-
-                node->children[letter] = TempNode{ .endingMetaData = endingMetaData };
-                STOP
-            }
+        STOP
+        const std::filesystem::path cacheFile = matchesString.empty() ? get_trigger_tree_cache_file(mMatchFile, mIncludes, mExcludes) : std::filesystem::path{};
+        auto compiledTree = std::make_shared<CompiledTriggerTree>();
+        // An incremental construction means some files have changed, the cache is outdated anyway.
+        if (std::set<std::filesystem::path> files;
+            !isIncremental && load_trigger_tree_cache(cacheFile, files, *compiledTree))
+        {
+            setImportedFiles(std::move(files));
+            // The builder is filled lazily with a full construction once a match file changes.
+            mBuilder->Clear();
             STOP
+
+            logger.Log(ELogLevel::INFO, mMatchFile, "Trigger tree loaded from the cache");
+            lambdaFinishConstruction(std::move(compiledTree));
+            return;
         }
         STOP
 
-        // TODO: Warn with triggersOverwritten
-
-        mTree.clear();
-        mEndings.clear();
-        mReplaceStrings.clear();
-        
-        /// Second iteration. Actually build the tree which will be used at runtime.
-        std::queue<TempNode*> nodes;
-        nodes.push(&root);
-        unsigned int height = 0;
-        // Traverse the tree in level-order, so that all the links of a node to be contiguous.
-        while (!nodes.empty())
-        {
-            const int index = static_cast<int>(mTree.size());
-
-            TempNode* node = nodes.front();
-            nodes.pop();
-            mTree.emplace_back(Node{ .parentIndex = node->parentIndex });
-            if (node->letter)
+        std::vector<MatchFileForParse> matchFilesParsed;
+        std::map<std::filesystem::path, unsigned long long> fileHashes;
+        if (matchesString.empty())
+        {
+            try
             {
-                mTree.back().letter = *node->letter;
+                std::tie(matchFilesParsed, fileHashes) = parse_matches(mMatchFile, mIncludes, mExcludes);
             }
-            height = std::max(height, node->height);
-            STOP
-
-            if (node->children.empty())
+            catch (const std::exception& e)
             {
-                mTree.back().endingIndex = static_cast<int>(mEndings.size());
-
-                // Improving on the duplicate detection turned out to be a NP-hard problem, it's known as the 'shortest common superstring problem'.
-                // Since the memory usage is not the first priority, it'll be fine with a simple solution like this.
-                int replaceStringIndex = -1;
-                if (const size_t result = mReplaceStrings.find(node->endingMetaData.replace);
-                    result == std::wstring::npos)
-                {
-                    replaceStringIndex = static_cast<int>(mReplaceStrings.size());
-                    mReplaceStrings.append(node->endingMetaData.replace);
-                }
-                else
+                // Thrown from the threads loading the files. The previous tree is kept, instead of terminating on this thread.
+                logger.Log(ELogLevel::ERROR, mMatchFile, "Failed to load the match files:", e.what());
+                mConstruction.Finish();
+                if (onFinish && !didCallOnFinish)
                 {
-                    replaceStringIndex = static_cast<int>(result);
+                    didCallOnFinish = true;
+                    onFinish();
                 }
-
-                Ending ending = node->endingMetaData.tempEnding;
-                ending.replaceStringIndex = replaceStringIndex;
-                ending.replaceStringLength = static_cast<int>(node->endingMetaData.replace.size());
-                mEndings.emplace_back(ending);
-                STOP
+                return;
             }
-
-            if (node->parentIndex >= 0)
-            {
-                Node& parent = mTree.at(node->parentIndex);
-                if (parent.childStartIndex < 0)
-                {
-                    parent.childStartIndex = index;
-                }
-                parent.childLength++;
-            }
-            STOP
-
-            for (auto& [letter, child] : node->children)
+            std::set<std::filesystem::path> importedFiles;
+            for (const std::filesystem::path& file : fileHashes | std::views::keys)
             {
-                child.parentIndex = index;
-                child.letter = &letter;
-                child.height = node->height + 1;
-                nodes.push(&child);
-                STOP
+                importedFiles.emplace(file);
             }
-            STOP
+            setImportedFiles(std::move(importedFiles));
+        }
+        else
+        {
+            matchFilesParsed.emplace_back(std::filesystem::path{}, parse_matches(std::string_view{ matchesString }));
+        }
+        STOP
+        std::vector<MatchFile> matchFiles;
+        matchFiles.reserve(matchFilesParsed.size());
+        for (auto& [file, matchesParsed] : matchFilesParsed)
+        {
+            std::vector<Match> matches;
+            matches.reserve(matchesParsed.size());
+            std::ranges::transform(matchesParsed, std::back_inserter(matches), [](const MatchForParse& match) { return match; });
+            matchFiles.emplace_back(std::move(file), std::move(matches));
         }
+        STOP
 
-        mTreeHeight = height;
-        mIsConstructingTriggerTree.store(false);
-        if (onFinish && !didCallOnFinish)
+        if (const bool isBuilt = isIncremental ? mBuilder->Update(std::move(matchFiles), stopToken) : mBuilder->Build(std::move(matchFiles), stopToken);
+            !isBuilt)
         {
-            didCallOnFinish = true;
-            onFinish();
+            // Stopped in the middle of patching, start over next time.
+            mBuilder->Clear();
         }
+        STOP
 
-        logger.Log(ELogLevel::INFO, mMatchFile, "Trigger tree construction finished");
+        // TODO: Warn about the triggers hidden by the others
+
+        // Not reusing the one above, which could be partially filled by a broken cache.
+        compiledTree = std::make_shared<CompiledTriggerTree>();
+        mBuilder->Flatten(*compiledTree);
+        compiledTree->replaceStrings = mBuilder->GetReplaceStrings();
+        save_trigger_tree_cache(cacheFile, fileHashes, *compiledTree);
+        STOP
+
+        lambdaFinishConstruction(std::move(compiledTree));
 
 #undef STOP
     } };
 }
 
 
+void TriggerTree::setImportedFiles(std::set<std::filesystem::path> files)
+{
+    for (const std::filesystem::path& file : mImportedFiles)
+    {
+        std::erase(trigger_trees_by_match_file.at(file), this);
+    }
+    mImportedFiles = std::move(files);
+    for (const std::filesystem::path& file : mImportedFiles)
+    {
+        trigger_trees_by_match_file[file].emplace_back(this);
+    }
+}
+
+
 void TriggerTree::ReconstructWith(std::filesystem::path matchFile)
 {
     mMatchFile = std::move(matchFile);
@@ -436,12 +368,15 @@ void TriggerTree::HaltConstruction()
 }
 
 
+void TriggerTree::ThenAfterConstruction(std::function<void()> onFinish)
+{
+    mConstruction.Then(std::move(onFinish));
+}
+
+
 void TriggerTree::WaitForConstruction() const
 {
-    while (mIsConstructingTriggerTree.load())
-    {
-        std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
-    }
+    mConstruction.Wait();
 }
 
 
@@ -453,30 +388,42 @@ void TriggerTree::ResetAgents()
 
 void TriggerTree::OnInput(const InputMessage(&inputs)[MAX_INPUT_COUNT], int length, bool clearAllAgents)
 {
-    if (mIsConstructingTriggerTree.load())
+    const LatencyProbe probe{ ELatencyProbe::TRIGGER_TREE_ON_INPUT };
+
+    // Keep matching with the current tree while a new one is being constructed, then move on to the new one once it's published.
+    if (std::shared_ptr<const CompiledTriggerTree> compiledTree = mCompiledTree.load();
+        compiledTree != mSessionTree)
     {
+        mSessionTree = std::move(compiledTree);
         mShouldResetAgents = true;
+    }
+    if (!mSessionTree)
+    {
+        // Not constructed yet.
         return;
     }
 
-    if (mShouldResetAgents || mIsTriggerTreeOutdated.load())
+    const Config::EMatchEngine matchEngine = get_config().matchEngine;
+    if (mShouldResetAgents || mMatchEngine != matchEngine)
     {
         mShouldResetAgents = false;
-        mIsTriggerTreeOutdated.store(false);
+        mMatchEngine = matchEngine;
 
         mAgents.clear();
         mNextIterationAgents.clear();
-        mStroke.clear();
-        mAgents.reserve(mTreeHeight);
-        mNextIterationAgents.reserve(mTreeHeight);
-        mStroke.resize(std::max(mTreeHeight, 1U), 0);
-        mRootAgent = { .node = &mTree.front(), .strokeStartIndex = static_cast<int>(mTreeHeight) };
+        mDeadAgents.clear();
+        mAgents.reserve(mSessionTree->height);
+        mNextIterationAgents.reserve(mSessionTree->height);
+        mStroke.Reset(std::max(mSessionTree->height, 1U));
+        mRootAgent = { .node = &mSessionTree->nodes.front(), .strokeStartIndex = static_cast<int>(mSessionTree->height) };
+        resetAutomaton();
     }
 
     if (clearAllAgents)
     {
         mAgents.clear();
         mDeadAgents.clear();
+        mAutomatonState = 0;
     }
 
     for (int i = 0; i < length; i++)
@@ -484,9 +431,66 @@ void TriggerTree::OnInput(const InputMessage(&inputs)[MAX_INPUT_COUNT], int leng
         logger.Log(ELogLevel::DEBUG, "input:", inputs[i].letter, static_cast<int>(inputs[i].isBeingComposed));
     }
 
+    switch (mMatchEngine)
+    {
+    case Config::EMatchEngine::AGENTS:
+        onInputWithAgents(inputs, length);
+        break;
+
+    case Config::EMatchEngine::AUTOMATON:
+        onInputWithAutomaton(inputs, length);
+        break;
+
+    default:
+        std::unreachable();
+    }
+}
+
+
+template<typename Func>
+bool CompiledTriggerTree::ForEachMatchingChild(const Node& node, wchar_t inputLetter, Func&& onChild) const
+{
+    const auto lambdaCheckChildren = [this, inputLetter, &onChild](ChildRange children)
+        {
+            const auto [childBegin, childEnd] = children;
+            for (int childIndex = childBegin; childIndex < childEnd; childIndex++)
+            {
+                // The folded letters are the same, only the case sensitive ones need to be checked further.
+                if (const wchar_t caseSensitiveLetter = caseSensitiveLetters[childIndex];
+                    caseSensitiveLetter != 0 && caseSensitiveLetter != inputLetter)
+                {
+                    continue;
+                }
+
+                // NOTE: multiple matches can happen(ex - case-sensitive one and non- one), hence not breaking
+                if (onChild(childIndex))
+                {
+                    return true;
+                }
+            }
+            return false;
+        };
+
+    const bool isRoot = &node == &nodes.front();
+    if (lambdaCheckChildren(isRoot ? FindRootChildren(inputLetter) : FindChildren(node, fold_case(inputLetter))))
+    {
+        return true;
+    }
+    // The non-word letter matches a whole class of letters, so it has its own equal range.
+    if (inputLetter != Letter::NON_WORD_LETTER && !is_alnum(inputLetter) &&
+        lambdaCheckChildren(isRoot ? rootDispatchTable.nonWord : FindChildren(node, Letter::NON_WORD_LETTER)))
+    {
+        return true;
+    }
+    return false;
+}
+
+
+void TriggerTree::onInputWithAgents(const InputMessage(&inputs)[MAX_INPUT_COUNT], int length)
+{
     if (length >= 0 && inputs[0].letter == L'\b')
     {
-        std::ranges::shift_right(mStroke, 1);
+        mStroke.Pop();
 
         // The input size is bigger than 1 only if letters are composed in the imm simulator.
         // But a backspace can't be used to finish composing(other than clearing one completely),
@@ -495,7 +499,7 @@ void TriggerTree::OnInput(const InputMessage(&inputs)[MAX_INPUT_COUNT], int leng
         {
             if (node->parentIndex >= 0)
             {
-                mNextIterationAgents.emplace_back(&mTree.at(node->parentIndex), strokeStartIndex + 1);
+                mNextIterationAgents.emplace_back(&mSessionTree->nodes.at(node->parentIndex), strokeStartIndex + 1);
             }
         }
         mAgents.clear();
@@ -517,49 +521,39 @@ void TriggerTree::OnInput(const InputMessage(&inputs)[MAX_INPUT_COUNT], int leng
     }
 
     // returns true if an ending was found
-    const auto lambdaAdvanceAgent = [this, length, inputs](const Agent& agent, wchar_t inputLetter, bool isBeingComposed, int inputIndex)
+    const auto lambdaAdvanceAgent = [this, length, &inputs](const Agent& agent, wchar_t inputLetter, bool isBeingComposed, int inputIndex)
         {
-            if (mIsTriggerTreeOutdated.load())
-            {
-                // Pretend a trigger was found so that the invalid agents are cleared & short-circuit the remaining checks.
-                return true;
-            }
-
-            const Node& node = *agent.node;
-            // TODO: Maybe use binary search(std::equal_range)? Should modify the spaceship operator too, then.
-
             bool didFindMatchingChild = false;
-            for (int childIndex = node.childStartIndex; childIndex < node.childStartIndex + node.childLength; childIndex++)
-            {
-                const Node& child = mTree.at(childIndex);
-                if (child.letter != inputLetter)
-                {
-                    continue;
-                }
-
-                Agent nextAgent{ .node = &child, .strokeStartIndex = agent.strokeStartIndex - 1 };
-                if (child.endingIndex < 0)
+            const bool isEndingFound = mSessionTree->ForEachMatchingChild(*agent.node, inputLetter,
+                [this, &agent, &didFindMatchingChild, isBeingComposed, inputIndex, length, &inputs](int childIndex)
                 {
-                    // If the letter is being composed, only check for the triggers, don't advance the agents.
-                    // ex - Typing '갃' should match '가' in the middle of the composition.
-                    // But we should not advance the agents since doing so would fail to match any Korean letters which are composed more than 1 letter.
-                    if (!isBeingComposed)
+                    const Node& child = mSessionTree->nodes[childIndex];
+                    Agent nextAgent{ .node = &child, .strokeStartIndex = agent.strokeStartIndex - 1 };
+                    if (!child.IsEnding())
                     {
-                        mNextIterationAgents.emplace_back(nextAgent);
-                        didFindMatchingChild = true;
+                        // If the letter is being composed, only check for the triggers, don't advance the agents.
+                        // ex - Typing '갃' should match '가' in the middle of the composition.
+                        // But we should not advance the agents since doing so would fail to match any Korean letters which are composed more than 1 letter.
+                        if (!isBeingComposed)
+                        {
+                            mNextIterationAgents.emplace_back(nextAgent);
+                            didFindMatchingChild = true;
+                        }
+                        return false;
                     }
-                    // NOTE: multiple matches can happen(ex - case-sensitive one and non- one), hence not breaking
-                    continue;
-                }
 
-                const bool doNeedFullComposite = child.letter.doNeedFullComposite;
-                if (doNeedFullComposite && isBeingComposed)
-                {
-                    continue;
-                }
+                    const bool doNeedFullComposite = child.DoesNeedFullComposite();
+                    if (doNeedFullComposite && isBeingComposed)
+                    {
+                        return false;
+                    }
 
-                replaceString(mEndings.at(child.endingIndex), nextAgent, mStroke, inputs, length, inputIndex, doNeedFullComposite);
+                    replaceString(mSessionTree->endings.at(child.GetEndingIndex()), nextAgent, mStroke.View(), inputs, length, inputIndex, doNeedFullComposite);
 
+                    return true;
+                });
+            if (isEndingFound)
+            {
                 return true;
             }
 
@@ -576,8 +570,7 @@ void TriggerTree::OnInput(const InputMessage(&inputs)[MAX_INPUT_COUNT], int leng
 
         if (!isBeingComposed)
         {
-            std::ranges::shift_left(mStroke, 1);
-            mStroke.back() = inputLetter;
+            mStroke.Push(inputLetter);
         }
 
         // Check for triggers in the root node first.
@@ -614,12 +607,328 @@ void TriggerTree::OnInput(const InputMessage(&inputs)[MAX_INPUT_COUNT], int leng
 }
 
 
+void TriggerTree::onInputWithAutomaton(const InputMessage(&inputs)[MAX_INPUT_COUNT], int length)
+{
+    const auto lambdaTransit = [this](wchar_t inputLetter, bool isBeingComposed)
+        {
+            const unsigned long long key =
+                (static_cast<unsigned long long>(mAutomatonState) << 32) |
+                (static_cast<unsigned long long>(inputLetter) << 1) |
+                static_cast<unsigned long long>(isBeingComposed);
+            auto it = mAutomatonTransitions.find(key);
+            if (it == mAutomatonTransitions.end())
+            {
+                it = mAutomatonTransitions.emplace(key, computeAutomatonTransition(mAutomatonState, inputLetter, isBeingComposed)).first;
+            }
+            return it->second;
+        };
+
+    if (length >= 0 && inputs[0].letter == L'\b')
+    {
+        mStroke.Pop();
+        mAutomatonState = lambdaTransit(L'\b', false).nextState;
+        return;
+    }
+
+    for (int i = 0; i < length; i++)
+    {
+        const auto [inputLetter, isBeingComposed] = inputs[i];
+
+        if (!isBeingComposed)
+        {
+            mStroke.Push(inputLetter);
+        }
+
+        const auto [nextState, endingNodeIndex] = lambdaTransit(inputLetter, isBeingComposed);
+        mAutomatonState = nextState;
+        if (endingNodeIndex >= 0)
+        {
+            const Node& child = mSessionTree->nodes[endingNodeIndex];
+            const Agent agent{ .node = &child, .strokeStartIndex = static_cast<int>(mSessionTree->height - mSessionTree->GetDepth(endingNodeIndex)) };
+            replaceString(mSessionTree->endings.at(child.GetEndingIndex()), agent, mStroke.View(), inputs, length, i, child.DoesNeedFullComposite());
+        }
+    }
+
+    // Since the states are never freed individually, start over once there are too many of them.
+    if (constexpr size_t MAX_STATE_COUNT = 1 << 16;
+        mAutomatonStates.size() > MAX_STATE_COUNT)
+    {
+        AutomatonState current = mAutomatonStates.at(mAutomatonState);
+        resetAutomaton();
+        mAutomatonState = internAutomatonState(std::move(current));
+    }
+}
+
+
+void TriggerTree::resetAutomaton()
+{
+    mAutomatonStates.clear();
+    mAutomatonStateIndices.clear();
+    mAutomatonTransitions.clear();
+    mAutomatonState = internAutomatonState({});  // No agents other than the root, the initial state.
+}
+
+
+int TriggerTree::internAutomatonState(AutomatonState state)
+{
+    const auto [it, isNew] = mAutomatonStateIndices.try_emplace(state, static_cast<int>(mAutomatonStates.size()));
+    if (isNew)
+    {
+        mAutomatonStates.emplace_back(std::move(state));
+    }
+    return it->second;
+}
+
+
+// Does what `onInputWithAgents` does to the agents, only with the indices of the nodes.
+AutomatonTransition TriggerTree::computeAutomatonTransition(int state, wchar_t inputLetter, bool isBeingComposed)
+{
+    // Copying, since interning a new state could invalidate the reference.
+    const AutomatonState current = mAutomatonStates.at(state);
+    const std::vector<Node>& nodes = mSessionTree->nodes;
+
+    if (inputLetter == L'\b')
+    {
+        AutomatonState next;
+        for (const int nodeIndex : current.agents)
+        {
+            if (const int parentIndex = nodes[nodeIndex].parentIndex;
+                parentIndex >= 0)
+            {
+                next.agents.emplace_back(parentIndex);
+            }
+        }
+        for (auto [nodeIndex, backspacesNeeded] : current.deadAgents)
+        {
+            if (--backspacesNeeded <= 0)
+            {
+                next.agents.emplace_back(nodeIndex);
+            }
+            else
+            {
+                next.deadAgents.emplace_back(nodeIndex, backspacesNeeded);
+            }
+        }
+        return { .nextState = internAutomatonState(std::move(next)) };
+    }
+
+    AutomatonState next{ .deadAgents = current.deadAgents };
+    int endingNodeIndex = -1;
+    const auto lambdaAdvanceAgent = [this, &nodes, &next, &endingNodeIndex, inputLetter, isBeingComposed](int nodeIndex)
+        {
+            bool didFindMatchingChild = false;
+            const bool isEndingFound = mSessionTree->ForEachMatchingChild(nodes[nodeIndex], inputLetter,
+                [&nodes, &next, &endingNodeIndex, &didFindMatchingChild, isBeingComposed](int childIndex)
+                {
+                    const Node& child = nodes[childIndex];
+                    if (!child.IsEnding())
+                    {
+                        if (!isBeingComposed)
+                        {
+                            next.agents.emplace_back(childIndex);
+                            didFindMatchingChild = true;
+                        }
+                        return false;
+                    }
+
+                    if (child.DoesNeedFullComposite() && isBeingComposed)
+                    {
+                        return false;
+                    }
+
+                    endingNodeIndex = childIndex;
+                    return true;
+                });
+            if (isEndingFound)
+            {
+                return true;
+            }
+
+            // The agents at the root are the same as the root agent, which never dies.
+            if (!didFindMatchingChild && nodeIndex != 0)
+            {
+                next.deadAgents.emplace_back(nodeIndex, 0);
+            }
+            return false;
+        };
+
+    if (lambdaAdvanceAgent(0) || std::ranges::any_of(current.agents, lambdaAdvanceAgent))
+    {
+        return { .nextState = 0, .endingNodeIndex = endingNodeIndex };
+    }
+
+    if (isBeingComposed)
+    {
+        next.agents = current.agents;
+    }
+    else
+    {
+        std::erase_if(next.deadAgents, [](std::pair<int, int>& deadAgent) { return ++deadAgent.second > get_config().maxBackspaceCount; });
+    }
+    return { .nextState = internAutomatonState(std::move(next)) };
+}
+
+
+unsigned int CompiledTriggerTree::GetDepth(int nodeIndex) const
+{
+    unsigned int depth = 0;
+    for (; nodeIndex > 0; nodeIndex = nodes[nodeIndex].parentIndex)
+    {
+        depth++;
+    }
+    return depth;
+}
+
+
+std::string CompiledTriggerTree::GetLayoutReport() const
+{
+    /// The layout before the packing, for the comparison.
+    struct UnpackedNode
+    {
+        int parentIndex;
+        int childStartIndex;
+        int childLength;
+        Letter letter;
+        int endingIndex;
+    };
+    struct UnpackedEnding
+    {
+        int replaceStringIndex;
+        int type;
+        unsigned int replaceStringLength;
+        unsigned int backspaceCount;
+        unsigned int cursorMoveCount;
+        bool propagateCase;
+        int uppercaseStyle;
+        bool keepComposite;
+    };
+
+    const size_t triggerCount = std::max<size_t>(endings.size(), 1);
+    const size_t replaceStringsSize = replaceStrings.size() * sizeof(wchar_t);
+    const size_t unpackedSize = nodes.size() * sizeof(UnpackedNode) + endings.size() * sizeof(UnpackedEnding) + replaceStringsSize;
+    const size_t packedSize = nodes.size() * sizeof(Node) + farChildren.size() * sizeof(FarChildren) + endings.size() * sizeof(Ending) + replaceStringsSize;
+    return std::format("triggers: {}, nodes: {}({} far), bytes per node: {} -> {}, bytes per ending: {} -> {}, bytes per trigger: {:.1f} -> {:.1f}",
+        endings.size(), nodes.size(), farChildren.size(), sizeof(UnpackedNode), sizeof(Node), sizeof(UnpackedEnding), sizeof(Ending),
+        static_cast<double>(unpackedSize) / triggerCount, static_cast<double>(packedSize) / triggerCount);
+}
+
+
+ChildRange CompiledTriggerTree::GetChildren(const Node& node) const
+{
+    if (node.IsEnding())
+    {
+        return { 0, 0 };
+    }
+
+    const auto nodeIndex = static_cast<int>(&node - nodes.data());
+    if (const unsigned int offset = node.link & 0xFFFF;
+        offset != Node::FAR_CHILDREN)
+    {
+        const int childBegin = nodeIndex + static_cast<int>(offset);
+        return { childBegin, childBegin + static_cast<int>(node.link >> 16) };
+    }
+
+    const auto it = std::ranges::lower_bound(farChildren, nodeIndex, {}, &FarChildren::nodeIndex);
+    return { it->childBegin, it->childEnd };
+}
+
+
+ChildRange CompiledTriggerTree::FindChildren(const Node& node, wchar_t foldedLetter) const
+{
+    const auto [childBegin, childEnd] = GetChildren(node);
+    if (childBegin == childEnd)
+    {
+        return { 0, 0 };
+    }
+
+    // Most of the nodes have only a few children, which are faster to scan all at once.
+    if (childEnd - childBegin <= MAX_SCANNED_CHILD_COUNT)
+    {
+        const std::span<const wchar_t> children{ foldedLetters.data() + childBegin, foldedLetters.data() + childEnd };
+        const auto first = static_cast<int>(find_letter(children, foldedLetter));
+        int last = first;
+        // The children are sorted by the folded letter, so the same ones are next to each other.
+        while (last < std::ssize(children) && children[last] == foldedLetter)
+        {
+            last++;
+        }
+        return { childBegin + first, childBegin + last };
+    }
+
+    const auto [first, last] = std::equal_range(foldedLetters.begin() + childBegin, foldedLetters.begin() + childEnd, foldedLetter);
+    return { static_cast<int>(first - foldedLetters.begin()), static_cast<int>(last - foldedLetters.begin()) };
+}
+
+
+ChildRange CompiledTriggerTree::FindRootChildren(wchar_t inputLetter) const
+{
+    if (inputLetter < rootDispatchTable.ascii.size())
+    {
+        return rootDispatchTable.ascii[inputLetter];
+    }
+
+    if (RootDispatchTable::JAMO_FIRST <= inputLetter && inputLetter <= RootDispatchTable::JAMO_LAST)
+    {
+        return rootDispatchTable.jamo[inputLetter - RootDispatchTable::JAMO_FIRST];
+    }
+
+    if (const auto it = rootDispatchTable.others.find(fold_case(inputLetter));
+        it != rootDispatchTable.others.end())
+    {
+        return it->second;
+    }
+
+    return {};
+}
+
+
+void CompiledTriggerTree::BuildLookupTables()
+{
+    foldedLetters.clear();
+    foldedLetters.reserve(nodes.size());
+    caseSensitiveLetters.clear();
+    caseSensitiveLetters.reserve(nodes.size());
+    for (const Node& node : nodes)
+    {
+        foldedLetters.emplace_back(fold_case(node.letter));
+        caseSensitiveLetters.emplace_back(node.IsCaseSensitive() ? node.letter : 0);
+    }
+
+    const Node& root = nodes.front();
+
+    for (wchar_t letter = 0; letter < rootDispatchTable.ascii.size(); letter++)
+    {
+        rootDispatchTable.ascii[letter] = FindChildren(root, fold_case(letter));
+    }
+    for (wchar_t letter = RootDispatchTable::JAMO_FIRST; letter <= RootDispatchTable::JAMO_LAST; letter++)
+    {
+        rootDispatchTable.jamo[letter - RootDispatchTable::JAMO_FIRST] = FindChildren(root, fold_case(letter));
+    }
+
+    // Include the ones covered above too, since a letter outside of them could be folded into them.
+    rootDispatchTable.others.clear();
+    const auto [rootChildBegin, rootChildEnd] = GetChildren(root);
+    for (int childIndex = rootChildBegin; childIndex < rootChildEnd; childIndex++)
+    {
+        const wchar_t foldedLetter = foldedLetters[childIndex];
+        if (!rootDispatchTable.others.contains(foldedLetter))
+        {
+            rootDispatchTable.others.emplace(foldedLetter, FindChildren(root, foldedLetter));
+        }
+    }
+
+    rootDispatchTable.nonWord = FindChildren(root, Letter::NON_WORD_LETTER);
+}
+
+
 void TriggerTree::replaceString(const Ending& ending, const Agent& agent, std::wstring_view stroke, const InputMessage(&inputs)[MAX_INPUT_COUNT], int inputLength, int inputIndex, bool doNeedFullComposite)
 {
-    const auto& [replaceStringIndex, replaceType, replaceStringLength, backspaceCount, cursorMoveCount,
+    const LatencyProbe probe{ ELatencyProbe::TRIGGER_TREE_REPLACE_STRING };
+
+    const auto& [replaceStringIndex, replaceStringLength, backspaceCount, cursorMoveCount, replaceType,
         propagateCase, uppercaseStyle, keepComposite] = ending;
 
-    const std::wstring_view originalReplaceString{ mReplaceStrings.data() + replaceStringIndex, replaceStringLength };
+    const std::wstring_view originalReplaceString{ mSessionTree->replaceStrings.data() + replaceStringIndex, replaceStringLength };
 
     imm_simulator.ClearComposition();
 
@@ -628,7 +937,8 @@ void TriggerTree::replaceString(const Ending& ending, const Agent& agent, std::w
     case Ending::EReplaceType::IMAGE:
     {
         push_current_clipboard_state();
-        std::vector<FakeInput> fakeInputs{ backspaceCount, FakeInput{ FakeInput::EType::KEY, FakeInput::BACKSPACE_KEY } };
+        std::vector<FakeInput>& fakeInputs = mReplaceBuffers.fakeInputs;
+        fakeInputs.assign(backspaceCount, FakeInput{ FakeInput::EType::KEY, FakeInput::BACKSPACE_KEY });
         if (set_clipboard_image(originalReplaceString))
         {
             // Popping the clipboard state is done in main.
@@ -638,20 +948,21 @@ void TriggerTree::replaceString(const Ending& ending, const Agent& agent, std::w
         {
             pop_clipboard_state();
         }
-        send_fake_inputs(fakeInputs, false);
+        sendReplaceInputs();
         return;
     }
 
     case Ending::EReplaceType::COMMAND:
     {
-        std::vector<FakeInput> fakeInputs{ backspaceCount, FakeInput{ FakeInput::EType::KEY, FakeInput::BACKSPACE_KEY } };
+        std::vector<FakeInput>& fakeInputs = mReplaceBuffers.fakeInputs;
+        fakeInputs.assign(backspaceCount, FakeInput{ FakeInput::EType::KEY, FakeInput::BACKSPACE_KEY });
         const auto& [str, ret] = run_command_and_get_output(originalReplaceString);
         fakeInputs.reserve(fakeInputs.size() + str.size());
         for (wchar_t c : str)
         {
             fakeInputs.emplace_back(FakeInput::EType::LETTER, c);
         }
-        send_fake_inputs(fakeInputs, false);
+        sendReplaceInputs();
         return;
     }
 
@@ -662,7 +973,22 @@ void TriggerTree::replaceString(const Ending& ending, const Agent& agent, std::w
         std::unreachable();
     }
 
-    std::wstring replaceString{ originalReplaceString };
+    // The replace strings for each case are made in advance, only one of them is picked here.
+    Ending::ECaseVariant caseVariant = Ending::ECaseVariant::AS_IS;
+    if (propagateCase)
+    {
+        const std::wstring_view triggerStroke = stroke.substr(agent.strokeStartIndex);
+        if (const auto triggerFirstCasedLetter = std::ranges::find_if(triggerStroke, [](wchar_t c) { return is_cased_alpha(c); });
+            triggerFirstCasedLetter != triggerStroke.end() && is_upper(*triggerFirstCasedLetter))
+        {
+            // If there is a lowercase letter in the stroke, only the first cased letter is capitalized. Otherwise, all the letters are.
+            caseVariant = std::ranges::any_of(triggerFirstCasedLetter, triggerStroke.end(), [](wchar_t c) { return is_lower(c); }) ?
+                Ending::ECaseVariant::CAPITALIZED : Ending::ECaseVariant::ALL_CAPS;
+        }
+    }
+
+    std::wstring& replaceString = mReplaceBuffers.replaceString;
+    replaceString.assign(originalReplaceString.data() + static_cast<size_t>(caseVariant) * replaceStringLength, replaceStringLength);
 
     unsigned int additionalCursorMoveCount = 0;
 
@@ -674,68 +1000,22 @@ void TriggerTree::replaceString(const Ending& ending, const Agent& agent, std::w
         }
     }
 
-    const std::wstring_view triggerStroke = stroke.substr(agent.strokeStartIndex);
-    if (propagateCase)
-    {
-        const auto triggerFirstCasedLetter = std::ranges::find_if(triggerStroke, [](wchar_t c) { return is_cased_alpha(c); });
-        if (std::iswupper(*triggerFirstCasedLetter))
-        {
-            if (std::ranges::any_of(triggerFirstCasedLetter, triggerStroke.end(), [](wchar_t c) { return is_cased_alpha(c) && std::iswlower(c); }))
-            {
-                // If there is a lowercase letter in the stroke, only the first cased letter is capitalized.
-                if (const auto it = std::ranges::find_if(originalReplaceString, [](wchar_t c) { return is_cased_alpha(c); });
-                    it != originalReplaceString.end())
-                {
-                    switch (uppercaseStyle)
-                    {
-                    case Match::EUppercaseStyle::FIRST_LETTER:
-                        replaceString.at(it - originalReplaceString.begin()) = std::towupper(*it);
-                        break;
-
-                    case Match::EUppercaseStyle::WORDS:
-                    {
-                        bool shouldBeUpper = true;
-                        for (wchar_t& c : replaceString)
-                        {
-                            if (shouldBeUpper && is_cased_alpha(c))
-                            {
-                                c = std::towupper(c);
-                                shouldBeUpper = false;
-                            }
-                            else if (!std::iswalnum(c))
-                            {
-                                shouldBeUpper = true;
-                            }
-                        }
-                        break;
-                    }
-
-                    default:
-                        std::unreachable();
-                    }
-                }
-            }
-            else
-            {
-                // Otherwise, capitalize all the letters.
-                std::ranges::transform(replaceString, replaceString.begin(), std::towupper);
-            }
-        }
-    }
-
     const std::wstring_view replace{ replaceString };
-    std::vector<FakeInput> fakeInputs;
+    std::vector<FakeInput>& fakeInputs = mReplaceBuffers.fakeInputs;
+    fakeInputs.clear();
     if (doNeedFullComposite)
     {
         const wchar_t lastLetter = inputs[inputLength - 1].letter;
         const bool isLastLetterKorean = is_korean(lastLetter);
         const bool didCompositionEndByAddingLetters = inputIndex + 1 < inputLength;
         unsigned int additionalBackspaceCount = std::max(inputLength - inputIndex - 2, 0) + static_cast<unsigned int>(didCompositionEndByAddingLetters);
-        std::wstring lastLetterString{ lastLetter };
+        std::wstring& lastLetterString = mReplaceBuffers.alphabets;
+        lastLetterString.assign(1, lastLetter);
         if (isLastLetterKorean && didCompositionEndByAddingLetters)
         {
-            const std::wstring lastLetterNormalized = normalize_hangeul(lastLetterString);
-            lastLetterString = hangeul_to_alphabet(lastLetterNormalized, false);
+            const std::wstring& lastLetterNormalized = mReplaceBuffers.normalized;
+            normalize_hangeul(std::wstring_view{ &lastLetter, 1 }, mReplaceBuffers.normalized);
+            hangeul_to_alphabet(lastLetterNormalized, false, lastLetterString);
             // The length of the middle letters + the last letter's decomposition.
             additionalBackspaceCount += static_cast<unsigned int>(lastLetterNormalized.size()) - 1;
             for (const wchar_t ch : lastLetterNormalized)
@@ -747,7 +1027,7 @@ void TriggerTree::replaceString(const Ending& ending, const Agent& agent, std::w
 
         // Note that we're not using the backspaceCount from the ending,
         // since the last letter of the replace string was decomposed to calculate the count (we don't want that here).
-        const unsigned int totalBackspaceCount = mTreeHeight - agent.strokeStartIndex + additionalBackspaceCount;
+        const unsigned int totalBackspaceCount = mSessionTree->height - agent.strokeStartIndex + additionalBackspaceCount;
         fakeInputs.reserve(
             totalBackspaceCount +
             replaceStringLength +
@@ -791,8 +1071,10 @@ void TriggerTree::replaceString(const Ending& ending, const Agent& agent, std::w
     }
     else if (keepComposite)
     {
-        const std::wstring lastLetterNormalized = normalize_hangeul(replace.substr(replaceStringLength - 1));
-        const std::wstring lastLetter = hangeul_to_alphabet(lastLetterNormalized, false);
+        const std::wstring& lastLetterNormalized = mReplaceBuffers.normalized;
+        const std::wstring& lastLetter = mReplaceBuffers.alphabets;
+        normalize_hangeul(replace.substr(replaceStringLength - 1), mReplaceBuffers.normalized);
+        hangeul_to_alphabet(lastLetterNormalized, false, mReplaceBuffers.alphabets);
 
         fakeInputs.reserve(backspaceCount + replaceStringLength + static_cast<int>(!is_hangeul_on) + lastLetter.size() - 1);
         std::fill_n(std::back_inserter(fakeInputs), backspaceCount, FakeInput{ FakeInput::EType::KEY, FakeInput::BACKSPACE_KEY });
@@ -828,5 +1110,24 @@ void TriggerTree::replaceString(const Ending& ending, const Agent& agent, std::w
         }
     }
 
-    send_fake_inputs(fakeInputs, false);
+    sendReplaceInputs();
+}
+
+
+void TriggerTree::sendReplaceInputs()
+{
+    {
+        const LatencyProbe probe{ ELatencyProbe::SEND_FAKE_INPUTS };
+        send_fake_inputs(mReplaceBuffers.fakeInputs, false);
+    }
+    mark_injection_end();
+
+    // The capacities never shrink, so any change means one of them has grown.
+    if (const size_t capacity = mReplaceBuffers.replaceString.capacity() + mReplaceBuffers.normalized.capacity() +
+            mReplaceBuffers.alphabets.capacity() + mReplaceBuffers.fakeInputs.capacity();
+        capacity != mReplaceBufferCapacity)
+    {
+        mReplaceBufferCapacity = capacity;
+        mReplaceBufferGrowthCount++;
+    }
 }
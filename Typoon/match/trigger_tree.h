@@ -1,11 +1,20 @@
 ﻿#pragma once
+#include <array>
+#include <atomic>
 #include <deque>
 #include <filesystem>
 #include <functional>
+#include <map>
+#include <memory>
 #include <set>
+#include <string>
 #include <thread>
+#include <unordered_map>
 
 #include "../input_multicast/input_multicast.h"
+#include "../low_level/fake_input.h"
+#include "../utils/completion.h"
+#include "../utils/config.h"
 #include "match.h"
 
 
@@ -41,48 +50,161 @@ struct Letter
 
     bool operator==(const Letter& other) const;
 
-    // NOTE: We don't need partial ordering, since we're already saying that case insensitive and same-if-lowered `Letter`s are equal.
+    // Ordered by the case folded letter first, so that the children of a node can be binary searched with a case folded input.
+    // Within the same folded letter, case sensitive ones come first, then the case insensitive one.
+    // NOTE: We don't need partial ordering, since we're already saying that case insensitive and same-if-folded `Letter`s are equal.
     std::strong_ordering operator<=>(const Letter& other) const;
 };
 
 
+// The [begin, end) index range of some children in the tree.
+using ChildRange = std::pair<int, int>;
+
+
 // A node of the tree. It's essentially a link, since a node doesn't hold any information.
+// Packed so that more of the siblings being searched share a cache line.
+// An ending node has no children once flattened, so the ending and the children share the same bits.
 struct Node
 {
+    /// Packed next to the letter.
+    enum EFlag : unsigned short
+    {
+        CASE_SENSITIVE = 1 << 0,
+        NEED_FULL_COMPOSITE = 1 << 1,
+        ENDING = 1 << 2,
+    };
+
+    // The child offset of a node whose children can't be packed in 16 bits each, they're in `CompiledTriggerTree::farChildren` then.
+    static constexpr unsigned int FAR_CHILDREN = 0xFFFF;
+
     int parentIndex = -1;
-    int childStartIndex = -1;
-    int childLength = 0;
-    Letter letter;
-    int endingIndex = -1;
+    wchar_t letter = 0;
+    unsigned short flags = 0;
+    // The index of the ending if `ENDING`.
+    // Otherwise, the offset from this node to the first child in the lower 16 bits, and the number of the children in the upper 16 bits.
+    unsigned int link = 0;
+
+    [[nodiscard]] bool IsCaseSensitive() const { return flags & CASE_SENSITIVE; }
+    [[nodiscard]] bool DoesNeedFullComposite() const { return flags & NEED_FULL_COMPOSITE; }
+    [[nodiscard]] bool IsEnding() const { return flags & ENDING; }
+    [[nodiscard]] int GetEndingIndex() const { return IsEnding() ? static_cast<int>(link) : -1; }
+    void SetLetter(const Letter& newLetter);
+    void SetEnding(int endingIndex);
+    // Returns false if they can't be packed.
+    [[nodiscard]] bool SetChildren(int nodeIndex, ChildRange children);
+};
+
+
+// The children of a node which can't be packed in it.
+struct FarChildren
+{
+    int nodeIndex = 0;
+    int childBegin = 0;
+    int childEnd = 0;
+};
+
+
+// A direct-indexed table from an input letter to the matching children of the root.
+// The root is by far the widest node, and every input starts from it.
+struct RootDispatchTable
+{
+    /// Hangul Compatibility Jamo, 'ㄱ' to 'ㆎ'
+    static constexpr wchar_t JAMO_FIRST = 0x3131;
+    static constexpr wchar_t JAMO_LAST = 0x318E;
+
+    std::array<ChildRange, 128> ascii{};  // Indexed by the input letter as-is.
+    std::array<ChildRange, JAMO_LAST - JAMO_FIRST + 1> jamo{};  // Indexed by the input letter as-is.
+    std::unordered_map<wchar_t, ChildRange> others;  // Keyed by the case folded input letter.
+    ChildRange nonWord{};
 };
 
 
 // The last letter of a trigger, contains the information for the replacement string.
 struct Ending
 {
-    enum class EReplaceType
+    enum class EReplaceType : unsigned char
     {
         TEXT,
         IMAGE,
         COMMAND,
     };
 
-    int replaceStringIndex = -1;
-    EReplaceType type = EReplaceType::TEXT;
+    /// The replace strings of the endings propagating the case, in the order they're stored.
+    enum class ECaseVariant
+    {
+        AS_IS,
+        CAPITALIZED,  // By `uppercaseStyle`
+        ALL_CAPS,
+
+        COUNT
+    };
+
+    /// Ordered by the size, so that there's no padding in between.
+    int replaceStringIndex = -1;  // If `propagateCase`, each of `ECaseVariant` follows one another, all of the same length.
     unsigned int replaceStringLength = 0;
-    unsigned int backspaceCount = 0;
-    unsigned int cursorMoveCount = 0;
+    unsigned short backspaceCount = 0;
+    unsigned short cursorMoveCount = 0;
+    EReplaceType type = EReplaceType::TEXT;
     bool propagateCase = false;  // Won't be true if the first letter is not cased.
     Match::EUppercaseStyle uppercaseStyle = Match::EUppercaseStyle::FIRST_LETTER;  // Only used if `propagateCase` is true.
     bool keepComposite = false;  // Won't be true if the letter is not Korean or need full composite.
 };
 
 
+// The compiled matches. Immutable once published, so that the matching can keep using it while a new one is being constructed.
+struct CompiledTriggerTree
+{
+    std::vector<Node> nodes;
+    std::vector<FarChildren> farChildren;  // Sorted by the node index.
+    /// The letters of `nodes` kept separately and index-aligned with it, so that searching the children touches only these.
+    std::vector<wchar_t> foldedLetters;  // Case folded.
+    std::vector<wchar_t> caseSensitiveLetters;  // As-is if the node is case sensitive, 0 otherwise.
+    RootDispatchTable rootDispatchTable;
+    unsigned int height = 0;
+    std::vector<Ending> endings;
+    std::wstring replaceStrings;
+
+    // Fills the letters and `rootDispatchTable` from `nodes`. Should be called before being published.
+    void BuildLookupTables();
+    // `node` should be one of `nodes`.
+    [[nodiscard]] ChildRange GetChildren(const Node& node) const;
+    // Returns the range of the children of `node` whose case folded letter is `foldedLetter`.
+    [[nodiscard]] ChildRange FindChildren(const Node& node, wchar_t foldedLetter) const;
+    // Same as `FindChildren(nodes.front(), fold_case(inputLetter))`, but in a constant time.
+    [[nodiscard]] ChildRange FindRootChildren(wchar_t inputLetter) const;
+    // Calls `onChild` with the index of each child of `node` that matches `inputLetter`, in the order they should be checked.
+    // Stops and returns true as soon as `onChild` returns true.
+    template<typename Func>
+    bool ForEachMatchingChild(const Node& node, wchar_t inputLetter, Func&& onChild) const;
+    [[nodiscard]] unsigned int GetDepth(int nodeIndex) const;
+    // The memory used by the tree per trigger, compared to the layout before the nodes and the endings were packed.
+    [[nodiscard]] std::string GetLayoutReport() const;
+};
+
+
+// The last letters typed, as many as the height of the tree.
+// Each letter is written twice, `capacity` apart, so that the last letters are always contiguous without shifting them.
+class StrokeBuffer
+{
+public:
+    void Reset(size_t capacity);
+    void Push(wchar_t letter);
+    void Pop();
+    // The last `capacity` letters, the latest at the back.
+    [[nodiscard]] std::wstring_view View() const { return { mBuffer.data() + mHead, mCapacity }; }
+
+private:
+    std::wstring mBuffer;
+    size_t mCapacity = 0;
+    size_t mHead = 0;  // Where `View` starts, always less than `mCapacity`.
+};
+
+
 // The agents for tracking the current possible triggers.
 struct Agent
 {
     const Node* node = nullptr;
-    int strokeStartIndex = -1;
+    int strokeStartIndex = -1;  // Where the letters up to `node` start in `StrokeBuffer::View`.
 
     constexpr bool operator==(const Agent& other) const noexcept = default;
 };
@@ -95,6 +217,27 @@ struct DeadAgent : Agent
 };
 
 
+// A state of the automaton engine, the nodes of the agents and the dead agents in the order the agents engine would keep them.
+struct AutomatonState
+{
+    std::vector<int> agents;
+    std::vector<std::pair<int, int>> deadAgents;  // With the backspaces needed to revive each of them.
+
+    auto operator<=>(const AutomatonState& other) const = default;
+};
+
+
+// A transition of the automaton engine, which is computed lazily and then cached.
+struct AutomatonTransition
+{
+    int nextState = 0;
+    int endingNodeIndex = -1;  // The node of the ending found, if any. The next state is always the initial state then.
+};
+
+
+class TriggerTreeBuilder;
+
+
 class TriggerTree
 {
 public:
@@ -106,15 +249,31 @@ public:
     TriggerTree& operator=(TriggerTree&& other) noexcept = delete;
 
     void Reconstruct(std::string_view matchesString = {}, std::function<void()> onFinish = {});
+    // Same as `Reconstruct`, but only the triggers of the matches changed since the last construction are patched.
+    void ReconstructIncrementally(std::string_view matchesString = {}, std::function<void()> onFinish = {});
     void ReconstructWith(std::filesystem::path matchFile);
     void HaltConstruction();
-    // For unit tests
+    // Calls `onFinish` once the ongoing construction is finished, or right away if there's none.
+    void ThenAfterConstruction(std::function<void()> onFinish);
     void WaitForConstruction() const;
+    // The number of times `ReplaceBuffers` had to grow, which stays the same once they're big enough.
+    // Only the buffers of the tree, not the ones of `send_fake_inputs` or the imm simulator.
+    [[nodiscard]] size_t GetReplaceBufferGrowthCount() const { return mReplaceBufferGrowthCount; }
     void ResetAgents();
     void OnInput(const InputMessage(&inputs)[MAX_INPUT_COUNT], int length, bool clearAllAgents);
 
 private:
+    void reconstruct(std::string_view matchesString, std::function<void()> onFinish, bool isIncremental);
+    void setImportedFiles(std::set<std::filesystem::path> files);
+
+    void onInputWithAgents(const InputMessage(&inputs)[MAX_INPUT_COUNT], int length);
+    void onInputWithAutomaton(const InputMessage(&inputs)[MAX_INPUT_COUNT], int length);
+    void resetAutomaton();
+    [[nodiscard]] int internAutomatonState(AutomatonState state);
+    [[nodiscard]] AutomatonTransition computeAutomatonTransition(int state, wchar_t inputLetter, bool isBeingComposed);
+
     void replaceString(const Ending& ending, const Agent& agent, std::wstring_view stroke, const InputMessage(&inputs)[MAX_INPUT_COUNT], int inputLength, int inputIndex, bool doNeedFullComposite);
+    void sendReplaceInputs();
 
 
 private:
@@ -122,21 +281,39 @@ private:
     std::vector<std::filesystem::path> mIncludes;
     std::vector<std::filesystem::path> mExcludes;
     std::set<std::filesystem::path> mImportedFiles;
+    std::unique_ptr<TriggerTreeBuilder> mBuilder;  // Only accessed in the constructor thread.
 
-    std::vector<Node> mTree;
-    unsigned int mTreeHeight = 0;
-    std::vector<Ending> mEndings;
-    std::wstring mReplaceStrings;
+    std::atomic<std::shared_ptr<const CompiledTriggerTree>> mCompiledTree;  // Swapped by the constructor thread once a new one is ready.
+    std::shared_ptr<const CompiledTriggerTree> mSessionTree;  // The one the agents below are on. Only accessed in the input thread.
 
     std::vector<Agent> mAgents{};
     std::vector<Agent> mNextIterationAgents{};
     std::deque<DeadAgent> mDeadAgents{};
-    std::wstring mStroke{};
+    StrokeBuffer mStroke{};
     bool mShouldResetAgents = false;
     Agent mRootAgent;
 
-    std::atomic<bool> mIsTriggerTreeOutdated = true;
-    std::atomic<bool> mIsConstructingTriggerTree = false;
+    /// Reused for every replacement, so that making the inputs of a replacement allocates nothing once they're big enough.
+    struct ReplaceBuffers
+    {
+        std::wstring replaceString;
+        std::wstring normalized;
+        std::wstring alphabets;
+        std::vector<FakeInput> fakeInputs;
+    } mReplaceBuffers;
+    size_t mReplaceBufferCapacity = 0;
+    size_t mReplaceBufferGrowthCount = 0;
+
+    /// The automaton engine. A state is where the agents and the dead agents would be, in the same order,
+    /// so that the same ending is found first. Therefore, a letter or a backspace is a single transition between the states,
+    /// instead of advancing every agent.
+    Config::EMatchEngine mMatchEngine = Config::EMatchEngine::AGENTS;
+    std::vector<AutomatonState> mAutomatonStates;
+    std::map<AutomatonState, int> mAutomatonStateIndices;
+    std::unordered_map<unsigned long long, AutomatonTransition> mAutomatonTransitions;  // Keyed by the state, the letter and whether it's being composed.
+    int mAutomatonState = 0;
+
+    Completion mConstruction;
 
     std::jthread mTriggerTreeConstructorThread;
 };
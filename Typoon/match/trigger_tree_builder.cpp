@@ -0,0 +1,592 @@
+#include "trigger_tree_builder.h"
+
+#include <algorithm>
+#include <limits>
+#include <queue>
+
+#include "../utils/config.h"
+#include "../utils/logger.h"
+#include "../utils/string.h"
+
+
+// The replace string as-is, with the first letter or the words capitalized, and all capitalized, one after another.
+// Which one to use depends on the cases of the letters typed, so that the expansion only has to pick one of them.
+std::wstring make_case_propagated_replaces(std::wstring_view replace, Match::EUppercaseStyle uppercaseStyle)
+{
+    std::wstring replaces;
+    replaces.reserve(replace.size() * static_cast<size_t>(Ending::ECaseVariant::COUNT));
+    replaces.append(replace);
+
+    std::wstring capitalized{ replace };
+    switch (uppercaseStyle)
+    {
+    case Match::EUppercaseStyle::FIRST_LETTER:
+        if (const auto it = std::ranges::find_if(capitalized, [](wchar_t c) { return is_cased_alpha(c); });
+            it != capitalized.end())
+        {
+            *it = to_upper(*it);
+        }
+        break;
+
+    case Match::EUppercaseStyle::WORDS:
+    {
+        bool shouldBeUpper = true;
+        for (wchar_t& c : capitalized)
+        {
+            if (shouldBeUpper && is_cased_alpha(c))
+            {
+                c = to_upper(c);
+                shouldBeUpper = false;
+            }
+            else if (!is_alnum(c))
+            {
+                shouldBeUpper = true;
+            }
+        }
+        break;
+    }
+
+    default:
+        std::unreachable();
+    }
+    replaces.append(capitalized);
+
+    std::ranges::transform(replace, std::back_inserter(replaces), to_upper);
+    return replaces;
+}
+
+
+// Of all the case variants if `propagateCase`.
+size_t get_replace_strings_length(const Ending& ending)
+{
+    return ending.replaceStringLength * (ending.propagateCase ? static_cast<size_t>(Ending::ECaseVariant::COUNT) : 1);
+}
+
+
+TriggerTreeBuilder::TriggerTreeBuilder()
+{
+    Clear();
+}
+
+
+bool TriggerTreeBuilder::Build(std::vector<MatchFile> matchFiles, const std::stop_token& stopToken)
+{
+    Clear();
+    mMatchFiles = std::move(matchFiles);
+
+    for (int fileIndex = 0; fileIndex < std::ssize(mMatchFiles); fileIndex++)
+    {
+        const std::vector<Match>& matches = mMatchFiles[fileIndex].matches;
+        for (int matchIndex = 0; matchIndex < std::ssize(matches); matchIndex++)
+        {
+            addMatch(matches[matchIndex], fileIndex, matchIndex);
+            if (stopToken.stop_requested())
+            {
+                return false;
+            }
+        }
+    }
+
+    mIsBuilt = true;
+    mCompactReplaceStringsLength = mReplaceStrings.GetStrings().size();
+    mReplaceStrings.LogStatistics();
+    // Not kept for the life of the tree, the strings added by the updates share only the exact duplicates.
+    mReplaceStrings.ReleaseSubstringIndex();
+    return true;
+}
+
+
+bool TriggerTreeBuilder::Update(std::vector<MatchFile> matchFiles, const std::stop_token& stopToken)
+{
+    if (!mIsBuilt || !std::ranges::equal(mMatchFiles, matchFiles, {}, &MatchFile::file, &MatchFile::file))
+    {
+        return Build(std::move(matchFiles), stopToken);
+    }
+
+    for (int fileIndex = 0; fileIndex < std::ssize(mMatchFiles); fileIndex++)
+    {
+        std::vector<Match>& oldMatches = mMatchFiles[fileIndex].matches;
+        std::vector<Match>& newMatches = matchFiles[fileIndex].matches;
+        if (oldMatches == newMatches)
+        {
+            continue;
+        }
+
+        // Usually only a few matches next to each other are changed in a save, so only diff the middle part
+        // between the unchanged prefix and suffix.
+        const int oldSize = static_cast<int>(oldMatches.size());
+        const int newSize = static_cast<int>(newMatches.size());
+        const int prefixLength = static_cast<int>(std::ranges::mismatch(oldMatches, newMatches).in1 - oldMatches.begin());
+        int suffixLength = 0;
+        while (suffixLength < std::min(oldSize, newSize) - prefixLength &&
+            oldMatches[oldSize - 1 - suffixLength] == newMatches[newSize - 1 - suffixLength])
+        {
+            suffixLength++;
+        }
+
+        for (int matchIndex = prefixLength; matchIndex < oldSize - suffixLength; matchIndex++)
+        {
+            removeMatch(oldMatches[matchIndex], fileIndex, matchIndex);
+        }
+        if (stopToken.stop_requested())
+        {
+            return false;
+        }
+
+        // The suffix is moved in the order that a match is never moved to where another is yet to be moved from.
+        if (const int offset = newSize - oldSize;
+            offset > 0)
+        {
+            for (int matchIndex = oldSize - 1; matchIndex >= oldSize - suffixLength; matchIndex--)
+            {
+                moveMatch(oldMatches[matchIndex], fileIndex, matchIndex, matchIndex + offset);
+            }
+        }
+        else if (offset < 0)
+        {
+            for (int matchIndex = oldSize - suffixLength; matchIndex < oldSize; matchIndex++)
+            {
+                moveMatch(oldMatches[matchIndex], fileIndex, matchIndex, matchIndex + offset);
+            }
+        }
+        if (stopToken.stop_requested())
+        {
+            return false;
+        }
+
+        for (int matchIndex = prefixLength; matchIndex < newSize - suffixLength; matchIndex++)
+        {
+            addMatch(newMatches[matchIndex], fileIndex, matchIndex);
+        }
+        if (stopToken.stop_requested())
+        {
+            return false;
+        }
+
+        oldMatches = std::move(newMatches);
+    }
+
+    // The strings of the removed endings are left in the pool, so it's compacted once they could be more than the rest.
+    if (mReplaceStrings.GetStrings().size() > 2 * std::min(mLiveReplaceStringsLength, mCompactReplaceStringsLength))
+    {
+        compactReplaceStrings();
+    }
+    mReplaceStrings.LogStatistics();
+    mReplaceStrings.ReleaseSubstringIndex();
+    return true;
+}
+
+
+void TriggerTreeBuilder::Clear()
+{
+    mNodes.clear();
+    mNodes.emplace_back();
+    mFreeNodeIndices.clear();
+    mMatchFiles.clear();
+    mReplaceStrings.Clear();
+    mLiveReplaceStringsLength = 0;
+    mCompactReplaceStringsLength = 0;
+    mIsBuilt = false;
+}
+
+
+void TriggerTreeBuilder::Flatten(CompiledTriggerTree& compiledTree) const
+{
+    struct NodeToFlatten
+    {
+        const BuildNode* node = nullptr;
+        int parentIndex = -1;
+        unsigned int height = 0;
+    };
+
+    std::vector<Node>& tree = compiledTree.nodes;
+    std::vector<Ending>& endings = compiledTree.endings;
+    tree.clear();
+    endings.clear();
+    compiledTree.farChildren.clear();
+    // Packed into the nodes once all of them are placed.
+    std::vector<ChildRange> children;
+
+    std::queue<NodeToFlatten> nodes;
+    nodes.push({ .node = &mNodes[ROOT_NODE_INDEX] });
+    unsigned int height = 0;
+    // Traverse the tree in level-order, so that all the links of a node to be contiguous.
+    while (!nodes.empty())
+    {
+        const int index = static_cast<int>(tree.size());
+
+        const NodeToFlatten current = nodes.front();
+        nodes.pop();
+        Node& node = tree.emplace_back(Node{ .parentIndex = current.parentIndex });
+        children.emplace_back(0, 0);
+        if (current.parentIndex >= 0)
+        {
+            Letter letter = current.node->letter;
+            letter.doNeedFullComposite = false;
+            node.SetLetter(letter);
+        }
+        height = std::max(height, current.height);
+
+        if (current.parentIndex >= 0)
+        {
+            // Any child comes after the root, so the range is empty only if not set yet.
+            auto& [childBegin, childEnd] = children.at(current.parentIndex);
+            if (childBegin == childEnd)
+            {
+                childBegin = index;
+                childEnd = index;
+            }
+            childEnd++;
+        }
+
+        // Since finding a match resets all the agents, the children of an ending can't be reached anyway.
+        if (!current.node->candidates.empty())
+        {
+            const Candidate& candidate = current.node->candidates.front();
+            node.SetLetter(candidate.letter);
+            node.SetEnding(static_cast<int>(endings.size()));
+            endings.emplace_back(candidate.ending);
+            continue;
+        }
+
+        for (const int childIndex : current.node->childIndices)
+        {
+            nodes.push({ .node = &mNodes[childIndex], .parentIndex = index, .height = current.height + 1 });
+        }
+    }
+
+    for (int index = 0; index < std::ssize(tree); index++)
+    {
+        if (!tree[index].IsEnding() && !tree[index].SetChildren(index, children[index]))
+        {
+            const auto [childBegin, childEnd] = children[index];
+            compiledTree.farChildren.emplace_back(index, childBegin, childEnd);
+        }
+    }
+    compiledTree.height = height;
+}
+
+
+void TriggerTreeBuilder::addMatch(const Match& match, int fileIndex, int matchIndex)
+{
+    int triggerIndex = 0;
+    forEachTrigger(match,
+        [this, fileIndex, matchIndex, &triggerIndex](const std::vector<Letter>& letters, Ending ending, std::wstring_view replace)
+        {
+            int nodeIndex = ROOT_NODE_INDEX;
+            for (const Letter& letter : letters)
+            {
+                nodeIndex = findOrAddChild(nodeIndex, letter);
+            }
+
+            ending.replaceStringIndex = addReplaceString(ending.propagateCase ? make_case_propagated_replaces(replace, ending.uppercaseStyle) : replace);
+            ending.replaceStringLength = static_cast<unsigned int>(replace.size());
+            mLiveReplaceStringsLength += get_replace_strings_length(ending);
+
+            Candidate candidate{
+                .order = { .fileIndex = fileIndex, .matchIndex = matchIndex, .triggerIndex = triggerIndex++ },
+                .letter = letters.back(),
+                .ending = ending,
+            };
+            std::vector<Candidate>& candidates = mNodes[nodeIndex].candidates;
+            candidates.insert(std::ranges::upper_bound(candidates, candidate.order, {}, &Candidate::order), std::move(candidate));
+        });
+}
+
+
+void TriggerTreeBuilder::removeMatch(const Match& match, int fileIndex, int matchIndex)
+{
+    int triggerIndex = 0;
+    forEachTrigger(match,
+        [this, fileIndex, matchIndex, &triggerIndex](const std::vector<Letter>& letters, const Ending&, std::wstring_view)
+        {
+            const TriggerOrder order{ .fileIndex = fileIndex, .matchIndex = matchIndex, .triggerIndex = triggerIndex++ };
+
+            std::vector<int> path;
+            const int nodeIndex = findNode(letters, &path);
+            if (nodeIndex < 0)
+            {
+                return;
+            }
+            std::erase_if(mNodes[nodeIndex].candidates, [this, order](const Candidate& candidate)
+                {
+                    if (candidate.order != order)
+                    {
+                        return false;
+                    }
+                    mLiveReplaceStringsLength -= get_replace_strings_length(candidate.ending);
+                    return true;
+                });
+
+            // Remove the nodes which are not leading to any ending anymore, from the bottom.
+            for (int i = static_cast<int>(letters.size()) - 1; i >= 0; i--)
+            {
+                const BuildNode& child = mNodes[path[i + 1]];
+                if (!child.candidates.empty() || !child.childIndices.empty())
+                {
+                    break;
+                }
+                removeChild(path[i], path[i + 1]);
+            }
+        });
+}
+
+
+void TriggerTreeBuilder::moveMatch(const Match& match, int fileIndex, int matchIndexFrom, int matchIndexTo)
+{
+    int triggerIndex = 0;
+    forEachTrigger(match,
+        [this, fileIndex, matchIndexFrom, matchIndexTo, &triggerIndex](const std::vector<Letter>& letters, const Ending&, std::wstring_view)
+        {
+            const TriggerOrder orderFrom{ .fileIndex = fileIndex, .matchIndex = matchIndexFrom, .triggerIndex = triggerIndex };
+            const TriggerOrder orderTo{ .fileIndex = fileIndex, .matchIndex = matchIndexTo, .triggerIndex = triggerIndex };
+            triggerIndex++;
+
+            const int nodeIndex = findNode(letters);
+            if (nodeIndex < 0)
+            {
+                return;
+            }
+            std::vector<Candidate>& candidates = mNodes[nodeIndex].candidates;
+            if (const auto it = std::ranges::find(candidates, orderFrom, &Candidate::order);
+                it != candidates.end())
+            {
+                it->order = orderTo;
+                std::ranges::sort(candidates, {}, &Candidate::order);
+            }
+        });
+}
+
+
+template<typename Func>
+void TriggerTreeBuilder::forEachTrigger(const Match& match, Func&& onTrigger)
+{
+    const auto& [originalTriggers, originalReplace, replaceImage, replaceCommand,
+        isCaseSensitive, isWord, doPropagateCase, uppercaseStyle,
+        doNeedFullComposite, doKeepComposite, isKorEngInsensitive] = match;
+
+    // TODO: Warn about empty triggers or replaces
+    if (originalTriggers.empty() || (originalReplace.empty() && replaceImage.empty() && replaceCommand.empty()))
+    {
+        return;
+    }
+
+    std::vector<std::wstring> triggers;
+    if (isKorEngInsensitive)
+    {
+        triggers.reserve(originalTriggers.size() * 2);
+        for (const std::wstring& originalTrigger : originalTriggers)
+        {
+            // A trigger could be mixed with Korean and English letters.
+            triggers.emplace_back(combine_hangeul(alphabet_to_hangeul(originalTrigger)));
+            triggers.emplace_back(hangeul_to_alphabet(normalize_hangeul(originalTrigger), false));
+        }
+    }
+    else
+    {
+        // A copy that could be avoided, but I think it's OK because normally there won't be many triggers,
+        // and each of them won't be too long.
+        triggers = originalTriggers;
+    }
+
+    std::wstring replaceStr{ originalReplace };
+    if (isWord)
+    {
+        replaceStr.push_back(Letter::LAST_INPUT_LETTER);
+    }
+
+    unsigned int cursorMoveCount = 0;
+    const std::wstring& cursorPlaceholder = get_config().cursorPlaceholder;
+    if (const size_t cursorIndex = originalReplace.find(cursorPlaceholder);
+        cursorIndex != std::wstring::npos)
+    {
+        replaceStr.erase(cursorIndex, cursorPlaceholder.size());
+        cursorMoveCount = static_cast<unsigned int>(replaceStr.size() - cursorIndex);
+    }
+
+    // The counts are kept small in the endings, a match that doesn't fit is skipped instead of moving the cursor wrong.
+    constexpr unsigned int MAX_COUNT = std::numeric_limits<unsigned short>::max();
+    if (cursorMoveCount > MAX_COUNT)
+    {
+        logger.Log(ELogLevel::WARNING, "The replace is too long after the cursor, skipping the match:", originalTriggers.front());
+        return;
+    }
+
+    const std::wstring_view replace = replaceStr;
+
+    const Ending::EReplaceType replaceType =
+        !replaceImage.empty() ? Ending::EReplaceType::IMAGE :
+        !replaceCommand.empty() ? Ending::EReplaceType::COMMAND :
+        Ending::EReplaceType::TEXT;
+    const Ending endingBase{
+        .cursorMoveCount = static_cast<unsigned short>(cursorMoveCount),
+        .type = replaceType,
+        // TODO: Abstract the extra conditions of the options and warn the user if ignored
+        .propagateCase = doPropagateCase && !isCaseSensitive && replaceType == Ending::EReplaceType::TEXT,
+        .uppercaseStyle = uppercaseStyle,
+        .keepComposite = doKeepComposite && is_korean(replace.back()) && replaceType == Ending::EReplaceType::TEXT,
+    };
+
+    const std::wstring endingReplace =
+        replaceType == Ending::EReplaceType::IMAGE ? replaceImage.generic_wstring() :
+        replaceType == Ending::EReplaceType::COMMAND ? replaceCommand :
+        std::wstring{ replace };
+
+    std::vector<Letter> letters;
+    for (const auto& originalTrigger : triggers)
+    {
+        std::wstring triggerStr{ originalTrigger };
+
+        if (isWord)
+        {
+            triggerStr.push_back(Letter::NON_WORD_LETTER);
+        }
+
+        if (triggerStr.empty())
+        {
+            continue;
+        }
+
+        const std::wstring_view trigger = triggerStr;
+
+        letters.clear();
+        letters.reserve(trigger.size());
+        // A node for each letter except the last one, that will be an 'ending node'.
+        for (auto triggerIt = trigger.begin(); triggerIt != trigger.end() - 1; ++triggerIt)
+        {
+            const wchar_t ch = *triggerIt;
+            letters.emplace_back(Letter{
+                .letter = ch,
+                .isCaseSensitive = isCaseSensitive && is_cased_alpha(ch),
+                .doNeedFullComposite = false
+            });
+        }
+
+        // The 'ending node'
+        const wchar_t triggerLastLetter = trigger.back();
+        auto backspaceCount = static_cast<unsigned int>(trigger.size());
+        const bool isTriggerLastLetterKorean = is_korean(triggerLastLetter);
+        // If the last letter is Korean, it's probably composed with more than 2 letters.
+        // The backspace count should be adjusted accordingly.
+        if (isTriggerLastLetterKorean)
+        {
+            backspaceCount += static_cast<int>(normalize_hangeul(std::wstring_view{ &triggerLastLetter, 1 }, {})) - 1;
+        }
+
+        if (backspaceCount > MAX_COUNT)
+        {
+            logger.Log(ELogLevel::WARNING, "The trigger is too long, skipping it:", originalTrigger);
+            continue;
+        }
+
+        const bool needFullComposite = doNeedFullComposite && isTriggerLastLetterKorean && !isWord && !isKorEngInsensitive;
+        letters.emplace_back(Letter{
+            .letter = triggerLastLetter,
+            .isCaseSensitive = isCaseSensitive && is_cased_alpha(triggerLastLetter) && !isKorEngInsensitive,
+            .doNeedFullComposite = needFullComposite
+        });
+
+        // TODO: Abstract the extra conditions of the options and warn the user if ignored
+        Ending ending = endingBase;
+        ending.backspaceCount = static_cast<unsigned short>(backspaceCount);
+        ending.propagateCase &= std::ranges::any_of(trigger, [](wchar_t c) { return is_cased_alpha(c); });
+        ending.keepComposite &= !needFullComposite && cursorMoveCount == 0 && (trigger.size() > 1 || triggerLastLetter != replace.back());
+
+        onTrigger(letters, ending, endingReplace);
+    }
+}
+
+
+int TriggerTreeBuilder::findNode(const std::vector<Letter>& letters, std::vector<int>* path) const
+{
+    int nodeIndex = ROOT_NODE_INDEX;
+    if (path)
+    {
+        path->emplace_back(nodeIndex);
+    }
+    for (const Letter& letter : letters)
+    {
+        const auto it = findChildPosition(nodeIndex, letter);
+        if (it == mNodes[nodeIndex].childIndices.end() || mNodes[*it].letter != letter)
+        {
+            return -1;
+        }
+        nodeIndex = *it;
+        if (path)
+        {
+            path->emplace_back(nodeIndex);
+        }
+    }
+    return nodeIndex;
+}
+
+
+std::vector<int>::const_iterator TriggerTreeBuilder::findChildPosition(int nodeIndex, const Letter& letter) const
+{
+    return std::ranges::lower_bound(mNodes[nodeIndex].childIndices, letter, {}, [this](int childIndex) -> const Letter& { return mNodes[childIndex].letter; });
+}
+
+
+int TriggerTreeBuilder::findOrAddChild(int nodeIndex, const Letter& letter)
+{
+    const auto it = findChildPosition(nodeIndex, letter);
+    if (it != mNodes[nodeIndex].childIndices.end() && (mNodes[*it].letter <=> letter) == 0)
+    {
+        // The existing letter is kept, which is the same as the new one when compared.
+        return *it;
+    }
+    // Taken before adding the node, which could move the arena.
+    const auto insertOffset = it - mNodes[nodeIndex].childIndices.begin();
+
+    BuildNode newNode{ .letter = letter };
+    int newIndex = 0;
+    if (!mFreeNodeIndices.empty())
+    {
+        newIndex = mFreeNodeIndices.back();
+        mFreeNodeIndices.pop_back();
+        mNodes[newIndex] = std::move(newNode);
+    }
+    else
+    {
+        newIndex = static_cast<int>(mNodes.size());
+        mNodes.emplace_back(std::move(newNode));
+    }
+
+    std::vector<int>& newChildIndices = mNodes[nodeIndex].childIndices;
+    newChildIndices.insert(newChildIndices.begin() + insertOffset, newIndex);
+    return newIndex;
+}
+
+
+void TriggerTreeBuilder::removeChild(int nodeIndex, int childIndex)
+{
+    std::erase(mNodes[nodeIndex].childIndices, childIndex);
+
+    mNodes[childIndex] = {};
+    mFreeNodeIndices.emplace_back(childIndex);
+}
+
+
+int TriggerTreeBuilder::addReplaceString(std::wstring_view replace)
+{
+    // Improving on the duplicate detection further turned out to be a NP-hard problem, it's known as the 'shortest common superstring problem'.
+    // The pool only reuses the strings already stored, which is good enough.
+    // NOTE: The strings of the removed endings are left behind until the pool is compacted, the same strings will be reused though.
+    return mReplaceStrings.Add(replace);
+}
+
+
+void TriggerTreeBuilder::compactReplaceStrings()
+{
+    const std::wstring oldStrings = mReplaceStrings.GetStrings();
+    mReplaceStrings.Clear();
+    for (BuildNode& node : mNodes)
+    {
+        for (Candidate& candidate : node.candidates)
+        {
+            Ending& ending = candidate.ending;
+            ending.replaceStringIndex = addReplaceString(std::wstring_view{ oldStrings }.substr(ending.replaceStringIndex, get_replace_strings_length(ending)));
+        }
+    }
+    mCompactReplaceStringsLength = mReplaceStrings.GetStrings().size();
+}
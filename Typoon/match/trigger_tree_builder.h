@@ -0,0 +1,96 @@
+#pragma once
+#include <compare>
+#include <filesystem>
+#include <stop_token>
+#include <string>
+#include <vector>
+
+#include "match.h"
+#include "replace_string_pool.h"
+#include "trigger_tree.h"
+
+
+// The matches written in a single match file, in the order they're written.
+struct MatchFile
+{
+    std::filesystem::path file;
+    std::vector<Match> matches;
+};
+
+
+// Builds the tree which will be flattened into `TriggerTree`.
+// The tree is kept after building, so that when some of the matches are changed, only the triggers of those are patched.
+class TriggerTreeBuilder
+{
+public:
+    TriggerTreeBuilder();
+
+    // Returns false if stopped, then the builder should be cleared.
+    bool Build(std::vector<MatchFile> matchFiles, const std::stop_token& stopToken);
+    // Patches the tree with the matches that are added, removed or moved in each file.
+    // Builds from scratch if the files themselves are changed, since the order of the triggers is based on them.
+    // Returns false if stopped, then the builder should be cleared.
+    bool Update(std::vector<MatchFile> matchFiles, const std::stop_token& stopToken);
+    void Clear();
+
+    // Flattens the tree in level-order, into the nodes, the endings and the height of `compiledTree`.
+    void Flatten(CompiledTriggerTree& compiledTree) const;
+    [[nodiscard]] const std::wstring& GetReplaceStrings() const { return mReplaceStrings.GetStrings(); }
+
+private:
+    // Where a trigger is in the matches. When multiple triggers end at the same node, the first one wins.
+    struct TriggerOrder
+    {
+        int fileIndex = 0;
+        int matchIndex = 0;
+        int triggerIndex = 0;
+
+        constexpr auto operator<=>(const TriggerOrder& other) const noexcept = default;
+    };
+
+    // An ending of a trigger, competing with the others ending at the same node.
+    struct Candidate
+    {
+        TriggerOrder order;
+        Letter letter;
+        Ending ending;
+    };
+
+    // The nodes are kept in a single arena and referred to by the indices, so that the removed ones are reused.
+    struct BuildNode
+    {
+        Letter letter;
+        std::vector<int> childIndices;  // Sorted by the letter, so that a child is found with a binary search.
+        // Sorted by the order. If not empty, the node is an ending and the children are unreachable.
+        // They're still kept, since removing the endings could make them reachable again.
+        std::vector<Candidate> candidates;
+    };
+    static constexpr int ROOT_NODE_INDEX = 0;
+
+    void addMatch(const Match& match, int fileIndex, int matchIndex);
+    void removeMatch(const Match& match, int fileIndex, int matchIndex);
+    void moveMatch(const Match& match, int fileIndex, int matchIndexFrom, int matchIndexTo);
+    // Calls `onTrigger` with the letters of each trigger of `match`(the last one being the ending) and the ending.
+    template<typename Func>
+    static void forEachTrigger(const Match& match, Func&& onTrigger);
+    // Returns the index of the node, -1 if not found.
+    [[nodiscard]] int findNode(const std::vector<Letter>& letters, std::vector<int>* path = nullptr) const;
+    // The first child whose letter isn't less than `letter`.
+    [[nodiscard]] std::vector<int>::const_iterator findChildPosition(int nodeIndex, const Letter& letter) const;
+    [[nodiscard]] int findOrAddChild(int nodeIndex, const Letter& letter);
+    void removeChild(int nodeIndex, int childIndex);
+    [[nodiscard]] int addReplaceString(std::wstring_view replace);
+    // Adds the strings of the endings in the tree to an empty pool, leaving out those of the removed ones.
+    void compactReplaceStrings();
+
+private:
+    std::vector<BuildNode> mNodes;  // The first one is the root.
+    std::vector<int> mFreeNodeIndices;  // Of the removed nodes, reused before growing the arena.
+    std::vector<MatchFile> mMatchFiles;
+    ReplaceStringPool mReplaceStrings{ true };  // Shares the substrings only while the pool is filled from empty.
+    // Of the endings in the tree, counting the shared strings each time, so the pool never needs more than this.
+    size_t mLiveReplaceStringsLength = 0;
+    // Of the pool when it had no strings of the removed endings.
+    size_t mCompactReplaceStringsLength = 0;
+    bool mIsBuilt = false;
+};
@@ -0,0 +1,305 @@
+#include "trigger_tree_cache.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <tuple>
+#include <type_traits>
+
+#include "../low_level/filesystem.h"
+#include "../utils/config.h"
+#include "../utils/logger.h"
+
+
+constexpr char TRIGGER_TREE_CACHE_MAGIC[4]{ 'T', 'Y', 'T', 'C' };
+// Bump whenever the layout of the cache or the data structures in it change.
+constexpr unsigned int TRIGGER_TREE_CACHE_VERSION = 3;
+
+static_assert(std::is_trivially_copyable_v<Node> && std::is_trivially_copyable_v<FarChildren> && std::is_trivially_copyable_v<Ending>,
+    "The tree is saved to the disk as-is.");
+static_assert(sizeof(bool) == 1 && sizeof(Ending::EReplaceType) == 1 && sizeof(Match::EUppercaseStyle) == 1,
+    "The bools and the enums of an ending are checked as bytes.");
+
+
+struct TriggerTreeCacheHeader
+{
+    char magic[4]{};
+    unsigned int version = 0;
+    unsigned long long configHash = 0;
+    unsigned int fileCount = 0;
+    unsigned int pathsLength = 0;  // Null terminated native paths of the imported files, after the hashes of them.
+    unsigned int nodeCount = 0;
+    unsigned int farChildrenCount = 0;
+    unsigned int endingCount = 0;
+    unsigned int replaceStringsLength = 0;
+    unsigned int treeHeight = 0;
+};
+
+
+// FNV-1a, it doesn't need to be cryptographic but just stable between runs.
+unsigned long long hash_bytes(const void* data, size_t size, unsigned long long hash = 14695981039346656037ULL)
+{
+    for (const auto* byte = static_cast<const unsigned char*>(data); size > 0; ++byte, --size)
+    {
+        hash = (hash ^ *byte) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+
+unsigned long long hash_match_file_content(std::string_view content)
+{
+    return hash_bytes(content.data(), content.size());
+}
+
+
+unsigned long long hash_file_content(const std::filesystem::path& file)
+{
+    std::ifstream ifs{ file, std::ios::binary };
+    if (!ifs)
+    {
+        // Distinguished from an empty file, so that a file being created later is detected.
+        return 0;
+    }
+    const std::string content{ std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>() };
+    return hash_match_file_content(content);
+}
+
+
+// Checked on the bytes before they're copied into an `Ending`, since a bool or an enum out of its range can't even be read.
+bool is_ending_valid(const char* endingBytes, size_t replaceStringsLength)
+{
+    const auto lambdaByte = [endingBytes](size_t offset) { return static_cast<unsigned char>(endingBytes[offset]); };
+    if (lambdaByte(offsetof(Ending, type)) > static_cast<unsigned char>(Ending::EReplaceType::COMMAND) ||
+        lambdaByte(offsetof(Ending, propagateCase)) > 1 ||
+        lambdaByte(offsetof(Ending, uppercaseStyle)) > static_cast<unsigned char>(Match::EUppercaseStyle::WORDS) ||
+        lambdaByte(offsetof(Ending, keepComposite)) > 1)
+    {
+        return false;
+    }
+
+    Ending ending;
+    std::memcpy(&ending, endingBytes, sizeof(Ending));
+    const size_t variantCount = ending.propagateCase ? static_cast<size_t>(Ending::ECaseVariant::COUNT) : 1;
+    return ending.replaceStringIndex >= 0 && ending.replaceStringIndex + ending.replaceStringLength * variantCount <= replaceStringsLength;
+}
+
+
+// The configs which affect the construction of the tree.
+unsigned long long hash_trigger_tree_config()
+{
+    const std::wstring& cursorPlaceholder = get_config().cursorPlaceholder;
+    return hash_bytes(cursorPlaceholder.data(), cursorPlaceholder.size() * sizeof(wchar_t));
+}
+
+
+std::filesystem::path get_trigger_tree_cache_file(const std::filesystem::path& matchFile,
+    const std::vector<std::filesystem::path>& includes, const std::vector<std::filesystem::path>& excludes)
+{
+    const std::filesystem::path cacheDirectory = get_cache_directory_path();
+    if (cacheDirectory.empty())
+    {
+        return {};
+    }
+
+    unsigned long long hash = hash_bytes(matchFile.native().data(), matchFile.native().size() * sizeof(std::filesystem::path::value_type));
+    for (const std::vector<std::filesystem::path>* paths : { &includes, &excludes })
+    {
+        // Separate the lists, so that moving a path from one to another makes a different hash.
+        hash = hash_bytes("|", 1, hash);
+        for (const std::filesystem::path& path : *paths)
+        {
+            hash = hash_bytes(path.native().data(), path.native().size() * sizeof(std::filesystem::path::value_type), hash);
+            hash = hash_bytes("", 1, hash);
+        }
+    }
+
+    return cacheDirectory / std::format(L"trigger_tree_{:016x}.bin", hash);
+}
+
+
+bool save_trigger_tree_cache(const std::filesystem::path& cacheFile, const std::map<std::filesystem::path, unsigned long long>& importedFiles,
+    const CompiledTriggerTree& tree)
+{
+    if (cacheFile.empty())
+    {
+        return false;
+    }
+
+    std::vector<unsigned long long> fileHashes;
+    std::filesystem::path::string_type paths;
+    fileHashes.reserve(importedFiles.size());
+    for (const auto& [file, fileHash] : importedFiles)
+    {
+        fileHashes.emplace_back(fileHash);
+        paths.append(file.native());
+        paths.push_back(0);
+    }
+
+    TriggerTreeCacheHeader header{
+        .version = TRIGGER_TREE_CACHE_VERSION,
+        .configHash = hash_trigger_tree_config(),
+        .fileCount = static_cast<unsigned int>(importedFiles.size()),
+        .pathsLength = static_cast<unsigned int>(paths.size()),
+        .nodeCount = static_cast<unsigned int>(tree.nodes.size()),
+        .farChildrenCount = static_cast<unsigned int>(tree.farChildren.size()),
+        .endingCount = static_cast<unsigned int>(tree.endings.size()),
+        .replaceStringsLength = static_cast<unsigned int>(tree.replaceStrings.size()),
+        .treeHeight = tree.height,
+    };
+    std::memcpy(header.magic, TRIGGER_TREE_CACHE_MAGIC, sizeof(header.magic));
+
+    // Write to a temporary file first, so that a half written cache is never read.
+    std::filesystem::path tempFile = cacheFile;
+    tempFile += ".tmp";
+    {
+        std::ofstream ofs{ tempFile, std::ios::binary | std::ios::trunc };
+        ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        ofs.write(reinterpret_cast<const char*>(fileHashes.data()), static_cast<std::streamsize>(fileHashes.size() * sizeof(unsigned long long)));
+        ofs.write(reinterpret_cast<const char*>(paths.data()), static_cast<std::streamsize>(paths.size() * sizeof(std::filesystem::path::value_type)));
+        ofs.write(reinterpret_cast<const char*>(tree.nodes.data()), static_cast<std::streamsize>(tree.nodes.size() * sizeof(Node)));
+        ofs.write(reinterpret_cast<const char*>(tree.farChildren.data()), static_cast<std::streamsize>(tree.farChildren.size() * sizeof(FarChildren)));
+        ofs.write(reinterpret_cast<const char*>(tree.endings.data()), static_cast<std::streamsize>(tree.endings.size() * sizeof(Ending)));
+        ofs.write(reinterpret_cast<const char*>(tree.replaceStrings.data()), static_cast<std::streamsize>(tree.replaceStrings.size() * sizeof(wchar_t)));
+        if (!ofs)
+        {
+            logger.Log(ELogLevel::WARNING, "Failed to write the trigger tree cache:", tempFile);
+            return false;
+        }
+    }
+
+    std::error_code errorCode;
+    std::filesystem::rename(tempFile, cacheFile, errorCode);
+    if (errorCode)
+    {
+        logger.Log(ELogLevel::WARNING, "Failed to write the trigger tree cache:", cacheFile, errorCode.message());
+        return false;
+    }
+    return true;
+}
+
+
+bool load_trigger_tree_cache(const std::filesystem::path& cacheFile, std::set<std::filesystem::path>& importedFiles, CompiledTriggerTree& tree)
+{
+    if (cacheFile.empty())
+    {
+        return false;
+    }
+
+    std::ifstream ifs{ cacheFile, std::ios::binary | std::ios::ate };
+    if (!ifs)
+    {
+        return false;
+    }
+    std::vector<char> data(static_cast<size_t>(ifs.tellg()));
+    ifs.seekg(0);
+    if (!ifs.read(data.data(), static_cast<std::streamsize>(data.size())) || data.size() < sizeof(TriggerTreeCacheHeader))
+    {
+        return false;
+    }
+
+    TriggerTreeCacheHeader header;
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (std::memcmp(header.magic, TRIGGER_TREE_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != TRIGGER_TREE_CACHE_VERSION ||
+        header.configHash != hash_trigger_tree_config() ||
+        data.size() != sizeof(header) + header.fileCount * sizeof(unsigned long long) + header.pathsLength * sizeof(std::filesystem::path::value_type) +
+            header.nodeCount * sizeof(Node) + header.farChildrenCount * sizeof(FarChildren) + header.endingCount * sizeof(Ending) +
+            header.replaceStringsLength * sizeof(wchar_t))
+    {
+        return false;
+    }
+
+    // Copying instead of casting the pointers, since the sections are not guaranteed to be aligned.
+    const char* cursor = data.data() + sizeof(header);
+    const auto lambdaRead = [&cursor]<typename T>(T* out, size_t count)
+        {
+            if (count > 0)
+            {
+                std::memcpy(out, cursor, count * sizeof(T));
+                cursor += count * sizeof(T);
+            }
+        };
+
+    std::vector<unsigned long long> fileHashes(header.fileCount);
+    std::filesystem::path::string_type paths(header.pathsLength, 0);
+    lambdaRead(fileHashes.data(), fileHashes.size());
+    lambdaRead(paths.data(), paths.size());
+
+    importedFiles.clear();
+    size_t pathStart = 0;
+    for (const unsigned long long fileHash : fileHashes)
+    {
+        const size_t pathEnd = paths.find(std::filesystem::path::value_type{ 0 }, pathStart);
+        if (pathEnd == std::filesystem::path::string_type::npos)
+        {
+            return false;
+        }
+        std::filesystem::path file{ paths.substr(pathStart, pathEnd - pathStart) };
+        if (hash_file_content(file) != fileHash)
+        {
+            logger.Log(ELogLevel::INFO, "Trigger tree cache is outdated:", file);
+            return false;
+        }
+        importedFiles.emplace(std::move(file));
+        pathStart = pathEnd + 1;
+    }
+
+    std::vector<Node>& nodes = tree.nodes;
+    std::vector<FarChildren>& farChildren = tree.farChildren;
+    std::vector<Ending>& endings = tree.endings;
+    std::wstring& replaceStrings = tree.replaceStrings;
+    nodes.resize(header.nodeCount);
+    farChildren.resize(header.farChildrenCount);
+    lambdaRead(nodes.data(), nodes.size());
+    lambdaRead(farChildren.data(), farChildren.size());
+
+    // A broken cache shouldn't crash the matching later.
+    bool areEndingsValid = true;
+    for (unsigned int i = 0; areEndingsValid && i < header.endingCount; i++)
+    {
+        areEndingsValid = is_ending_valid(cursor + i * sizeof(Ending), header.replaceStringsLength);
+    }
+    if (areEndingsValid)
+    {
+        endings.resize(header.endingCount);
+        replaceStrings.resize(header.replaceStringsLength);
+        lambdaRead(endings.data(), endings.size());
+        lambdaRead(replaceStrings.data(), replaceStrings.size());
+    }
+    tree.height = header.treeHeight;
+
+    const auto lambdaIsChildRangeValid = [&nodes](int childBegin, int childEnd)
+        {
+            return childBegin == childEnd || (childBegin > 0 && childBegin < childEnd && childEnd <= static_cast<int>(nodes.size()));
+        };
+    const bool areFarChildrenValid = std::ranges::is_sorted(farChildren, {}, &FarChildren::nodeIndex) && std::ranges::all_of(farChildren,
+        [&nodes, &lambdaIsChildRangeValid](const FarChildren& children)
+        {
+            return children.nodeIndex >= 0 && children.nodeIndex < static_cast<int>(nodes.size()) && lambdaIsChildRangeValid(children.childBegin, children.childEnd);
+        });
+    bool isTreeValid = areEndingsValid && !nodes.empty() && areFarChildrenValid;
+    for (int nodeIndex = 0; isTreeValid && nodeIndex < std::ssize(nodes); nodeIndex++)
+    {
+        const Node& node = nodes[nodeIndex];
+        // Only the root has no parent, and a parent is always before its children, so there's no cycle.
+        isTreeValid = (nodeIndex == 0 ? node.parentIndex == -1 : node.parentIndex >= 0 && node.parentIndex < nodeIndex) &&
+            (!node.IsEnding() || (node.GetEndingIndex() >= 0 && node.GetEndingIndex() < static_cast<int>(endings.size())));
+        if (isTreeValid && !node.IsEnding())
+        {
+            // The far children are checked above, only whether they're there.
+            isTreeValid = (node.link & 0xFFFF) == Node::FAR_CHILDREN ?
+                std::ranges::binary_search(farChildren, nodeIndex, {}, &FarChildren::nodeIndex) :
+                std::apply(lambdaIsChildRangeValid, tree.GetChildren(node));
+        }
+    }
+    if (!isTreeValid)
+    {
+        logger.Log(ELogLevel::WARNING, "Trigger tree cache is broken:", cacheFile);
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <filesystem>
+#include <map>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "trigger_tree.h"
+
+
+// The cache of a flattened trigger tree, so that the match files don't need to be parsed when nothing has changed since the last run.
+// It's valid as long as the contents of the imported files and the configs affecting the tree are the same.
+
+// Returns an empty path if caching is not available.
+std::filesystem::path get_trigger_tree_cache_file(const std::filesystem::path& matchFile,
+    const std::vector<std::filesystem::path>& includes, const std::vector<std::filesystem::path>& excludes);
+
+// The hash of a match file saved in the cache, of the content as it was read for parsing.
+unsigned long long hash_match_file_content(std::string_view content);
+
+// Only the nodes, the far children, the endings, the replace strings and the height of `tree` are saved.
+// `importedFiles` are with the hashes of their contents, so that a file changed after it was parsed makes the cache outdated.
+bool save_trigger_tree_cache(const std::filesystem::path& cacheFile, const std::map<std::filesystem::path, unsigned long long>& importedFiles,
+    const CompiledTriggerTree& tree);
+
+// Loaded with a single read. Returns false if there's no valid cache, then the outputs are left unspecified.
+bool load_trigger_tree_cache(const std::filesystem::path& cacheFile, std::set<std::filesystem::path>& importedFiles, CompiledTriggerTree& tree);
@@ -1,15 +1,20 @@
 #include "trigger_trees_per_program.h"
 
+#include <map>
 #include <ranges>
+#include <tuple>
 
 #include "../utils/logger.h"
 
 
 std::list<TriggerTree> trigger_trees;
 std::unordered_map<std::wstring, TriggerTree*> trigger_tree_by_program;
+// Multiple overrides can share a tree, so the agents are reset when moving between them as if they had their own.
+std::unordered_map<std::wstring, int> override_index_by_program;
 
 std::wstring current_program;
 TriggerTree* current_trigger_tree = nullptr;
+int current_override_index = -1;
 
 std::filesystem::path default_match_file;
 
@@ -37,8 +42,10 @@ void teardown_trigger_trees()
     std::erase_if(input_listeners, [](const std::pair<std::string, InputListener>& pair) { return pair.first == "trigger_tree"; });
     trigger_trees.clear();
     trigger_tree_by_program.clear();
+    override_index_by_program.clear();
     current_program.clear();
     current_trigger_tree = nullptr;
+    current_override_index = -1;
     default_match_file.clear();
 }
 
@@ -64,8 +71,10 @@ void set_current_program(const std::wstring& program)
 
     logger.Log(ELogLevel::DEBUG, "Program changed to:", program);
 
+    const auto it = override_index_by_program.find(program);
+    const int nextOverrideIndex = it != override_index_by_program.end() ? it->second : -1;
     if (TriggerTree* next = get_trigger_tree(program);
-        current_trigger_tree != next)
+        current_trigger_tree != next || current_override_index != nextOverrideIndex)
     {
         if (next)
         {
@@ -74,12 +83,14 @@ void set_current_program(const std::wstring& program)
         current_trigger_tree = next;
     }
 
+    current_override_index = nextOverrideIndex;
+
     current_program = program;
 }
 
 
 template <typename T>
-void reconstruct(T& treesToReconstruct, std::function<void()> onFinished)
+void reconstruct(T& treesToReconstruct, std::function<void()> onFinished, bool isIncremental = false)
 {
     if (treesToReconstruct.empty())
     {
@@ -109,13 +120,23 @@ void reconstruct(T& treesToReconstruct, std::function<void()> onFinished)
 
     for (auto& triggerTree : treesToReconstruct)
     {
+        TriggerTree* tree = nullptr;
         if constexpr (std::is_pointer_v<std::remove_reference_t<decltype(triggerTree)>>)
         {
-            triggerTree->Reconstruct({}, lambdaOnConstructionFinished);
+            tree = triggerTree;
+        }
+        else
+        {
+            tree = &triggerTree;
+        }
+
+        if (isIncremental)
+        {
+            tree->ReconstructIncrementally({}, lambdaOnConstructionFinished);
         }
         else
         {
-            triggerTree.Reconstruct({}, lambdaOnConstructionFinished);
+            tree->Reconstruct({}, lambdaOnConstructionFinished);
         }
     }
 }
@@ -129,7 +150,8 @@ void reconstruct_all_trigger_trees(std::function<void()> onFinished)
 
 void reconstruct_trigger_trees_with_file(const std::filesystem::path& matchFile, std::function<void()> onFinished)
 {
-    reconstruct(trigger_trees_by_match_file[matchFile], std::move(onFinished));
+    // Only the matches of the file are changed, the other files are read from the cache.
+    reconstruct(trigger_trees_by_match_file[matchFile], std::move(onFinished), true);
 }
 
 
@@ -139,14 +161,35 @@ void update_trigger_tree_program_overrides(const std::vector<ProgramOverride>& p
     ++it;
     trigger_trees.erase(it, trigger_trees.end());
     trigger_tree_by_program.clear();
+    override_index_by_program.clear();
     trigger_tree_by_program[DEFAULT_PROGRAM_NAME] = &trigger_trees.front();
 
-    for (const auto& [programs, disable, matchFilePath, includes, excludes] : programOverrides)
+    // The overrides with the same sources share a tree, since the trees would be identical.
+    using TriggerTreeSources = std::tuple<std::filesystem::path, std::vector<std::filesystem::path>, std::vector<std::filesystem::path>>;
+    std::map<TriggerTreeSources, TriggerTree*> trigger_tree_by_sources{
+        { { default_match_file.lexically_normal(), {}, {} }, &trigger_trees.front() },
+    };
+
+    for (int overrideIndex = 0; const auto& [programs, disable, matchFilePath, includes, excludes] : programOverrides)
     {
-        TriggerTree* newTree = disable ? nullptr: &trigger_trees.emplace_back(matchFilePath.empty() ? default_match_file : matchFilePath, includes, excludes);
+        TriggerTree* newTree = nullptr;
+        if (!disable)
+        {
+            const auto [treeIt, isNew] = trigger_tree_by_sources.try_emplace({ (matchFilePath.empty() ? default_match_file : matchFilePath).lexically_normal(), includes, excludes });
+            if (isNew)
+            {
+                treeIt->second = &trigger_trees.emplace_back(std::get<0>(treeIt->first), includes, excludes);
+            }
+            newTree = treeIt->second;
+        }
+
         for (const std::wstring& program : programs)
         {
             trigger_tree_by_program[program] = newTree;
+            override_index_by_program[program] = overrideIndex;
         }
+        overrideIndex++;
     }
+
+    logger.Log(ELogLevel::INFO, "Program overrides:", programOverrides.size(), "Trigger trees:", trigger_trees.size());
 }
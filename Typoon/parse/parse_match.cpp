@@ -1,6 +1,18 @@
 ﻿#include "parse_match.h"
 
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+
 #include "../low_level/tray_icon.h"
+#include "../match/trigger_tree_cache.h"
 #include "../utils/json5_util.h"
 #include "../utils/logger.h"
 #include "../utils/string.h"
@@ -52,32 +64,33 @@ MatchForParse::operator Match() const
 }
 
 
-std::unordered_map<std::filesystem::path, std::vector<MatchForParse>> matches_cache;
+// A match file read and parsed, but not put in the order yet.
+struct LoadedMatchFile
+{
+    std::vector<std::filesystem::path> imports;  // Including the excluded ones, since the excludes differ by the programs.
+    std::vector<MatchForParse> matches;
+    std::wstring errorString;  // Not empty if the file is invalid.
+    unsigned long long contentHash = 0;  // Of the content parsed, 0 if it couldn't be read.
+};
 
 
-std::vector<MatchForParse> parse_matches(const std::filesystem::path& file, std::set<std::filesystem::path>& importedFiles,
-    const std::vector<std::filesystem::path>& excludes)
-{
-    const std::filesystem::path normalizedPath = file.lexically_normal();
-    if (auto [_, wasNew] = importedFiles.insert(normalizedPath);
-        !wasNew)
-    {
-        logger.Log(ELogLevel::WARNING, "Circular import detected:", file);
-        return {};
-    }
+json5::error parse_matches(const json5::document& doc, std::vector<MatchForParse>& matches);
+void report_invalid_matches(json5::error err);
 
-    std::wstring errorString;
+
+LoadedMatchFile load_match_file(const std::filesystem::path& file)
+{
+    LoadedMatchFile loadedFile;
     if (std::ifstream ifs{ file })
     {
         const std::string str{ std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>() };
+        loadedFile.contentHash = hash_match_file_content(str);
 
         json5::document doc;
         json5::error err;
         if (err = from_string(str, doc);
             err == json5::error::none)
         {
-            std::vector<MatchForParse> matches;
-
             struct Imports
             {
                 std::vector<std::filesystem::path> imports;
@@ -90,79 +103,339 @@ std::vector<MatchForParse> parse_matches(const std::filesystem::path& file, std:
             {
                 for (const std::filesystem::path& importPath : imports.imports)
                 {
-                    const std::filesystem::path& absolutePath = importPath.is_absolute() ? importPath : (file.parent_path() / importPath);
-                    if (std::ranges::find(excludes, absolutePath) != excludes.end())
-                    {
-                        continue;
-                    }
-
-                    std::vector<MatchForParse> importedMatches = parse_matches(absolutePath, importedFiles, excludes);
-                    std::ranges::move(importedMatches, std::back_inserter(matches));
+                    loadedFile.imports.emplace_back(importPath.is_absolute() ? importPath : (file.parent_path() / importPath));
                 }
             }
 
-            if (const auto it = matches_cache.find(normalizedPath);
-                it != matches_cache.end())
+            if (err = parse_matches(doc, loadedFile.matches);
+                err != json5::error::none)
             {
-                matches.insert_range(matches.end(), it->second);
+                report_invalid_matches(err);
             }
-            else
+            return loadedFile;
+        }
+
+        loadedFile.errorString = json5_error_to_string(err);
+    }
+
+    if (loadedFile.errorString.empty())
+    {
+        char msg[256]{ 0, };
+        strerror_s(msg, errno);
+        loadedFile.errorString = { std::begin(msg), std::begin(msg) + std::strlen(msg) + 1 };
+    }
+    return loadedFile;
+}
+
+
+// Shared by the trigger trees of all the programs, which are constructed at the same time.
+// Each file is loaded only once even if requested by multiple threads at once, the others wait for the one loading it.
+class MatchesCache
+{
+public:
+    std::shared_ptr<const LoadedMatchFile> GetOrLoad(const std::filesystem::path& file)
+    {
+        const std::filesystem::path normalizedPath = file.lexically_normal();
+        {
+            std::shared_lock lock{ mMutex };
+            if (const auto it = mEntries.find(normalizedPath);
+                it != mEntries.end())
             {
-                std::vector<MatchForParse> mainMatches = parse_matches(std::string_view{ str });
-                matches_cache[normalizedPath] = mainMatches;
+                const std::shared_future<std::shared_ptr<const LoadedMatchFile>> loadedFile = it->second.loadedFile;
+                lock.unlock();
+                return loadedFile.get();
+            }
+        }
 
-                std::ranges::move(mainMatches, std::back_inserter(matches));
+        std::promise<std::shared_ptr<const LoadedMatchFile>> promise;
+        unsigned int generation = 0;
+        {
+            std::unique_lock lock{ mMutex };
+            const auto [it, isNew] = mEntries.try_emplace(normalizedPath, promise.get_future().share(), mNextGeneration);
+            if (!isNew)
+            {
+                // Another thread has started loading it in the meantime.
+                const std::shared_future<std::shared_ptr<const LoadedMatchFile>> loadedFile = it->second.loadedFile;
+                lock.unlock();
+                return loadedFile.get();
             }
-            return matches;
+            generation = mNextGeneration++;
+        }
+
+        std::shared_ptr<const LoadedMatchFile> loadedFile;
+        try
+        {
+            loadedFile = std::make_shared<const LoadedMatchFile>(load_match_file(file));
+        }
+        catch (...)
+        {
+            // The threads waiting for it get the exception too, instead of a broken promise.
+            eraseEntry(normalizedPath, generation);
+            promise.set_exception(std::current_exception());
+            throw;
         }
 
-        errorString = json5_error_to_string(err);
+        if (!loadedFile->errorString.empty())
+        {
+            // Not cached, so that the file is read again next time, e.g. when it was being written by another program.
+            eraseEntry(normalizedPath, generation);
+        }
+        promise.set_value(loadedFile);
+        return loadedFile;
     }
 
-    if (errorString.empty())
+    void Invalidate(const std::filesystem::path& file)
     {
-        char msg[256]{ 0, };
-        strerror_s(msg, errno);
-        errorString = { std::begin(msg), std::begin(msg) + std::strlen(msg) + 1 };
+        std::unique_lock lock{ mMutex };
+        mEntries.erase(file.lexically_normal());
     }
 
-    logger.Log(ELogLevel::ERROR, file, "Match file is invalid.", errorString);
-    show_notification(L"Match File Parse Error", L"File: " + file.generic_wstring() + L"Error: " + errorString);
+    void Clear()
+    {
+        std::unique_lock lock{ mMutex };
+        mEntries.clear();
+    }
 
-    return {};
+private:
+    struct Entry
+    {
+        std::shared_future<std::shared_ptr<const LoadedMatchFile>> loadedFile;
+        unsigned int generation = 0;  // To tell if the entry is still the same one after it's invalidated and loaded again.
+    };
+
+    void eraseEntry(const std::filesystem::path& normalizedPath, unsigned int generation)
+    {
+        std::unique_lock lock{ mMutex };
+        if (const auto it = mEntries.find(normalizedPath);
+            it != mEntries.end() && it->second.generation == generation)
+        {
+            mEntries.erase(it);
+        }
+    }
+
+    std::shared_mutex mMutex;
+    std::unordered_map<std::filesystem::path, Entry> mEntries;
+    unsigned int mNextGeneration = 0;
+} matches_cache;
+
+
+// Shared by all the trigger trees too, so that constructing many of them at once doesn't start threads for each of them.
+class MatchLoadingPool
+{
+public:
+    // The task shouldn't throw.
+    void Submit(std::function<void()> task)
+    {
+        {
+            std::lock_guard lock{ mMutex };
+            mTasks.emplace_back(std::move(task));
+            if (mWorkers.empty())
+            {
+                const unsigned int workerCount = std::clamp(std::thread::hardware_concurrency(), 1U, MAX_WORKER_COUNT);
+                mWorkers.reserve(workerCount);
+                for (unsigned int i = 0; i < workerCount; i++)
+                {
+                    mWorkers.emplace_back([this](const std::stop_token& stopToken) { work(stopToken); });
+                }
+            }
+        }
+        mCondition.notify_one();
+    }
+
+private:
+    void work(const std::stop_token& stopToken)
+    {
+        std::unique_lock lock{ mMutex };
+        while (mCondition.wait(lock, stopToken, [this]() { return !mTasks.empty(); }))
+        {
+            const std::function<void()> task = std::move(mTasks.front());
+            mTasks.pop_front();
+            lock.unlock();
+            task();
+            lock.lock();
+        }
+    }
+
+    static constexpr unsigned int MAX_WORKER_COUNT = 8;
+
+    std::mutex mMutex;
+    std::condition_variable_any mCondition;
+    std::deque<std::function<void()>> mTasks;
+    std::vector<std::jthread> mWorkers;  // Started with the first task. Last, so that they're joined before the rest is destroyed.
+} match_loading_pool;
+
+
+bool is_excluded(const std::filesystem::path& file, const std::vector<std::filesystem::path>& excludes)
+{
+    return std::ranges::find(excludes, file) != excludes.end();
 }
 
 
-std::pair<std::vector<MatchForParse>, std::set<std::filesystem::path>> parse_matches(const std::filesystem::path& file,
-    const std::vector<std::filesystem::path>& includes, const std::vector<std::filesystem::path>& excludes)
+// Loads the files and all the files imported by them concurrently, keyed by the normalized paths.
+// The imports of a file are scheduled as soon as the file is read, so that independent files don't wait for each other.
+std::unordered_map<std::filesystem::path, std::shared_ptr<const LoadedMatchFile>> load_match_files(const std::vector<std::filesystem::path>& files,
+    const std::vector<std::filesystem::path>& excludes)
+{
+    std::unordered_map<std::filesystem::path, std::shared_ptr<const LoadedMatchFile>> loadedFiles;
+    int loadingCount = 0;
+    std::exception_ptr exception;
+    std::mutex mutex;
+    std::condition_variable condition;
+
+    // Should be called with the mutex locked.
+    std::function<void(const std::filesystem::path&)> lambdaSchedule;
+    lambdaSchedule = [&](const std::filesystem::path& file)
+        {
+            if (const auto [_, isNew] = loadedFiles.try_emplace(file.lexically_normal());
+                !isNew)
+            {
+                return;
+            }
+
+            loadingCount++;
+            match_loading_pool.Submit([&, file]()
+                {
+                    std::shared_ptr<const LoadedMatchFile> loadedFile;
+                    std::exception_ptr loadingException;
+                    try
+                    {
+                        loadedFile = matches_cache.GetOrLoad(file);
+                    }
+                    catch (...)
+                    {
+                        loadingException = std::current_exception();
+                    }
+
+                    std::lock_guard lock{ mutex };
+                    if (loadedFile)
+                    {
+                        for (const std::filesystem::path& importPath : loadedFile->imports)
+                        {
+                            if (!is_excluded(importPath, excludes))
+                            {
+                                lambdaSchedule(importPath);
+                            }
+                        }
+                        loadedFiles[file.lexically_normal()] = std::move(loadedFile);
+                    }
+                    else if (!exception)
+                    {
+                        exception = std::move(loadingException);
+                    }
+
+                    if (--loadingCount == 0)
+                    {
+                        // Nothing is being loaded, so nothing will be scheduled anymore.
+                        condition.notify_all();
+                    }
+                });
+        };
+
+    std::unique_lock lock{ mutex };
+    for (const std::filesystem::path& file : files)
+    {
+        lambdaSchedule(file);
+    }
+    condition.wait(lock, [&loadingCount]() { return loadingCount == 0; });
+
+    if (exception)
+    {
+        std::rethrow_exception(exception);
+    }
+    return loadedFiles;
+}
+
+
+// Puts the loaded files in the order of the matches to be added, the imported matches coming first.
+void order_match_files(const std::filesystem::path& file, const std::unordered_map<std::filesystem::path, std::shared_ptr<const LoadedMatchFile>>& loadedFiles,
+    const std::vector<std::filesystem::path>& excludes, std::map<std::filesystem::path, unsigned long long>& importedFiles, std::vector<MatchFileForParse>& matchFiles)
 {
-    std::set<std::filesystem::path> importedFiles;
-    std::vector<MatchForParse> matches = parse_matches(file, importedFiles, excludes);
+    const std::filesystem::path normalizedPath = file.lexically_normal();
+    const LoadedMatchFile& loadedFile = *loadedFiles.at(normalizedPath);
+    if (auto [_, wasNew] = importedFiles.try_emplace(normalizedPath, loadedFile.contentHash);
+        !wasNew)
+    {
+        logger.Log(ELogLevel::WARNING, "Circular import detected:", file);
+        return;
+    }
 
+    if (!loadedFile.errorString.empty())
+    {
+        logger.Log(ELogLevel::ERROR, file, "Match file is invalid.", loadedFile.errorString);
+        show_notification(L"Match File Parse Error", L"File: " + file.generic_wstring() + L"Error: " + loadedFile.errorString);
+        return;
+    }
+
+    for (const std::filesystem::path& importPath : loadedFile.imports)
+    {
+        if (!is_excluded(importPath, excludes))
+        {
+            order_match_files(importPath, loadedFiles, excludes, importedFiles, matchFiles);
+        }
+    }
+
+    // Copying, since the cached ones are shared.
+    matchFiles.emplace_back(normalizedPath, loadedFile.matches);
+}
+
+
+std::pair<std::vector<MatchFileForParse>, std::map<std::filesystem::path, unsigned long long>> parse_matches(const std::filesystem::path& file,
+    const std::vector<std::filesystem::path>& includes, const std::vector<std::filesystem::path>& excludes)
+{
+    std::vector<std::filesystem::path> files{ file };
     for (const std::filesystem::path& includePath : includes)
     {
-        std::vector<MatchForParse> importedMatches = parse_matches(includePath.is_absolute() ? includePath : (file.parent_path() / includePath),
-            importedFiles, excludes);
-        std::ranges::move(importedMatches, std::back_inserter(matches));
+        files.emplace_back(includePath.is_absolute() ? includePath : (file.parent_path() / includePath));
     }
 
-    return { std::move(matches), std::move(importedFiles) };
+    // Reading and parsing the files is done concurrently, but the order is decided afterward in a single thread,
+    // so that the result is the same as parsing them one by one.
+    const std::unordered_map<std::filesystem::path, std::shared_ptr<const LoadedMatchFile>> loadedFiles = load_match_files(files, excludes);
+
+    std::map<std::filesystem::path, unsigned long long> importedFiles;
+    std::vector<MatchFileForParse> matchFiles;
+    for (const std::filesystem::path& matchFile : files)
+    {
+        order_match_files(matchFile, loadedFiles, excludes, importedFiles, matchFiles);
+    }
+
+    return { std::move(matchFiles), std::move(importedFiles) };
 }
 
 
 void invalidate_matches_cache(const std::filesystem::path& file)
 {
-    matches_cache.erase(file.lexically_normal());
+    matches_cache.Invalidate(file);
 }
 
 
 void invalidate_all_matches_cache()
 {
-    matches_cache.clear();
+    matches_cache.Clear();
 }
 
 
 std::vector<MatchForParse> parse_matches(std::string_view matchesString)
+{
+    json5::document doc;
+    json5::error err;
+    std::vector<MatchForParse> matches;
+    if (err = from_string(matchesString, doc);
+        err == json5::error::none)
+    {
+        if (err = parse_matches(doc, matches);
+            err == json5::error::none)
+        {
+            return matches;
+        }
+    }
+
+    report_invalid_matches(err);
+    return {};
+}
+
+
+json5::error parse_matches(const json5::document& doc, std::vector<MatchForParse>& matches)
 {
     struct MatchesAndGroupsForParse
     {
@@ -172,39 +445,37 @@ std::vector<MatchForParse> parse_matches(std::string_view matchesString)
         JSON5_MEMBERS(groups, matches)
     };
 
-    json5::document doc;
-    json5::error err;
-    if (err = from_string(matchesString, doc);
-        err == json5::error::none)
+    MatchesAndGroupsForParse matchesAndGroups;
+    if (const json5::error err = json5::from_document(doc, matchesAndGroups);
+        err != json5::error::none)
     {
-        MatchesAndGroupsForParse matchesAndGroups;
-
-        if (err = json5::from_document(doc, matchesAndGroups);
-            err == json5::error::none)
-        {
-            size_t matchesLengthInGroups = 0;
-            for (GroupForParse& group : matchesAndGroups.groups)
-            {
-                matchesLengthInGroups += group.matches.size();
-            }
-            matchesAndGroups.matches.reserve(matchesAndGroups.matches.size() + matchesLengthInGroups);
+        return err;
+    }
 
-            for (GroupForParse& group : matchesAndGroups.groups)
-            {
-                for (MatchForParse& match : group.matches)
-                {
-                    match |= group;
-                    matchesAndGroups.matches.emplace_back(std::move(match));
-                }
-            }
+    size_t matchesLengthInGroups = 0;
+    for (GroupForParse& group : matchesAndGroups.groups)
+    {
+        matchesLengthInGroups += group.matches.size();
+    }
+    matchesAndGroups.matches.reserve(matchesAndGroups.matches.size() + matchesLengthInGroups);
 
-            return matchesAndGroups.matches;
+    for (GroupForParse& group : matchesAndGroups.groups)
+    {
+        for (MatchForParse& match : group.matches)
+        {
+            match |= group;
+            matchesAndGroups.matches.emplace_back(std::move(match));
         }
     }
 
+    matches = std::move(matchesAndGroups.matches);
+    return { json5::error::none };
+}
+
+
+void report_invalid_matches(json5::error err)
+{
     const std::wstring errorString = json5_error_to_string(err);
     logger.Log(ELogLevel::ERROR, "Matches string is invalid.", errorString);
     show_notification(L"Match File Parse Error", errorString);
-
-    return {};
 }
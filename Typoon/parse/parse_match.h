@@ -1,5 +1,6 @@
 ﻿#pragma once
 #include <filesystem>
+#include <map>
 #include <string>
 #include <set>
 #include <vector>
@@ -55,7 +56,16 @@ struct GroupForParse : OptionContainerForParse
 JSON5_ENUM(OptionContainerForParse::EUppercaseStyle, first_letter, capitalize_words)
 
 
-std::pair<std::vector<MatchForParse>, std::set<std::filesystem::path>> parse_matches(const std::filesystem::path& file,
+// The matches written in a single match file, excluding the imported ones.
+struct MatchFileForParse
+{
+    std::filesystem::path file;
+    std::vector<MatchForParse> matches;
+};
+
+
+// Returns the matches of each file in the order they should be added, and all the files imported with the hashes of the contents parsed.
+std::pair<std::vector<MatchFileForParse>, std::map<std::filesystem::path, unsigned long long>> parse_matches(const std::filesystem::path& file,
     const std::vector<std::filesystem::path>& includes, const std::vector<std::filesystem::path>& excludes);
 void invalidate_matches_cache(const std::filesystem::path& file);
 void invalidate_all_matches_cache();
@@ -0,0 +1,61 @@
+#include "../../low_level/compression.h"
+
+#include <Windows.h>
+#include <compressapi.h>
+
+#include "log.h"
+
+
+// Fast enough for the background, while still shrinking the logs several times.
+constexpr DWORD COMPRESSION_ALGORITHM = COMPRESS_ALGORITHM_XPRESS_HUFF;
+
+
+bool compress_bytes(std::span<const std::byte> data, std::vector<std::byte>& compressed)
+{
+    COMPRESSOR_HANDLE compressor = nullptr;
+    if (!CreateCompressor(COMPRESSION_ALGORITHM, nullptr, &compressor))
+    {
+        log_last_error(L"CreateCompressor failed:");
+        return false;
+    }
+
+    // Asks for the size of the buffer first.
+    SIZE_T compressedSize = 0;
+    bool isSucceeded = Compress(compressor, data.data(), data.size(), nullptr, 0, &compressedSize) || GetLastError() == ERROR_INSUFFICIENT_BUFFER;
+    if (isSucceeded)
+    {
+        compressed.resize(compressedSize);
+        isSucceeded = Compress(compressor, data.data(), data.size(), compressed.data(), compressed.size(), &compressedSize);
+        compressed.resize(compressedSize);
+    }
+    if (!isSucceeded)
+    {
+        log_last_error(L"Compress failed:");
+    }
+
+    CloseCompressor(compressor);
+    return isSucceeded;
+}
+
+
+bool decompress_bytes(std::span<const std::byte> compressed, size_t rawSize, std::vector<std::byte>& data)
+{
+    DECOMPRESSOR_HANDLE decompressor = nullptr;
+    if (!CreateDecompressor(COMPRESSION_ALGORITHM, nullptr, &decompressor))
+    {
+        log_last_error(L"CreateDecompressor failed:");
+        return false;
+    }
+
+    data.resize(rawSize);
+    SIZE_T decompressedSize = 0;
+    const bool isSucceeded = Decompress(decompressor, compressed.data(), compressed.size(), data.data(), data.size(), &decompressedSize) &&
+        decompressedSize == rawSize;
+    if (!isSucceeded)
+    {
+        log_last_error(L"Decompress failed:", ELogLevel::WARNING);
+    }
+
+    CloseDecompressor(decompressor);
+    return isSucceeded;
+}
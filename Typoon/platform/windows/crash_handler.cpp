@@ -38,6 +38,7 @@ long WINAPI on_exception(EXCEPTION_POINTERS* exceptions)
     const HANDLE file = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
 
     logger.Log(reinterpret_cast<unsigned long long>(GetModuleHandle(nullptr)));
+    logger.Flush();
     MiniDumpWriteDump(GetCurrentProcess(), GetCurrentProcessId(), file, static_cast<MINIDUMP_TYPE>(flags), &exceptionInfo, nullptr, &callbackInfo);
 
     return EXCEPTION_CONTINUE_SEARCH;
@@ -16,7 +16,9 @@ const wchar_t FakeInput::ENTER_KEY = VK_RETURN;
 
 void send_fake_inputs(const std::vector<FakeInput>& inputs, bool isCapsLockOn)
 {
-    std::vector<INPUT> inputsToSend;
+    // Reused, so that nothing is allocated once it's big enough.
+    static thread_local std::vector<INPUT> inputsToSend;
+    inputsToSend.clear();
     inputsToSend.reserve(inputs.size() * 2);
 
     for (const auto& [type, letter] : inputs)
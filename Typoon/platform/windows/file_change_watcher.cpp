@@ -28,10 +28,7 @@ FileChangeWatcher::FileChangeWatcher(std::function<void(const std::filesystem::p
 
                 if (mIsBeingModified.load())
                 {
-                    while (mIsBeingModified.load())
-                    {
-                        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-                    }
+                    mIsBeingModified.wait(true);
                     continue;
                 }
 
@@ -104,6 +101,8 @@ void FileChangeWatcher::AddWatchingFile(const std::filesystem::path& filePath)
     if (dir == INVALID_HANDLE_VALUE) [[unlikely]]
     {
         log_last_error(L"CreateFile error:");
+        mIsBeingModified = false;
+        mIsBeingModified.notify_all();
         return;
     }
 
@@ -115,6 +114,7 @@ void FileChangeWatcher::AddWatchingFile(const std::filesystem::path& filePath)
     readDirectoryChanges(static_cast<int>(mFiles.size() - 1));
 
     mIsBeingModified = false;
+    mIsBeingModified.notify_all();
 }
 
 
@@ -152,6 +152,7 @@ void FileChangeWatcher::Reset(bool killThread)
     }
 
     mIsBeingModified = false;
+    mIsBeingModified.notify_all();
 }
 
 
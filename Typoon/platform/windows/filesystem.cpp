@@ -38,26 +38,56 @@ const std::filesystem::path& get_config_file_path()
 
 
 std::filesystem::path get_log_file_path()
+{
+    // Rotated by the logger, into the segments next to it.
+    std::filesystem::path path = get_app_data_path() / "logs" / "typoon.tylog";
+    std::filesystem::create_directories(path.parent_path());
+    return path;
+}
+
+
+std::filesystem::path get_crash_file_path()
 {
     using namespace std::chrono;
 
     static const auto tz = current_zone();
 
     const auto now = zoned_time{ tz, system_clock::now() };
-    std::filesystem::path path = get_app_data_path() / "logs" / std::format(L"{0:%Y-%m-%d}.txt", now);
+    std::filesystem::path path = get_app_data_path() / "crashes" / std::format(L"{0:%Y-%m-%d %H-%M-%S}.dmp", now);
     std::filesystem::create_directories(path.parent_path());
     return path;
 }
 
 
-std::filesystem::path get_crash_file_path()
+std::filesystem::path get_latency_report_file_path()
 {
     using namespace std::chrono;
 
     static const auto tz = current_zone();
 
     const auto now = zoned_time{ tz, system_clock::now() };
-    std::filesystem::path path = get_app_data_path() / "crashes" / std::format(L"{0:%Y-%m-%d %H-%M-%S}.dmp", now);
+    std::filesystem::path path = get_app_data_path() / "latency" / std::format(L"{0:%Y-%m-%d %H-%M-%S}.txt", now);
     std::filesystem::create_directories(path.parent_path());
     return path;
 }
+
+
+const std::filesystem::path& get_cache_directory_path()
+{
+    static std::filesystem::path cachePath{
+        []() -> std::filesystem::path
+        {
+            if (get_app_data_path().empty())
+            {
+                return {};
+            }
+
+            std::filesystem::path path = get_app_data_path() / "cache";
+            std::error_code errorCode;
+            std::filesystem::create_directories(path, errorCode);
+            return errorCode ? std::filesystem::path{} : path;
+        }()
+    };
+
+    return cachePath;
+}
@@ -8,9 +8,11 @@
 
 #include "../../common/common.h"
 #include "../../low_level/clipboard.h"
+#include "../../low_level/filesystem.h"
 #include "../../low_level/tray_icon.h"
 #include "../../low_level/window_focus.h"
 #include "../../utils/config.h"
+#include "../../utils/latency_probe.h"
 #include "log.h"
 #include "wnd_proc.h"
 
@@ -295,6 +297,19 @@ void start_hot_key_watcher(const std::any& data)
                 break;
             }
 
+            case EHotKeyType::DUMP_LATENCY_REPORT:
+            {
+                const std::filesystem::path reportFile = get_latency_report_file_path();
+                if (!dump_latency_report(reportFile))
+                {
+                    show_notification(L"Failed to save the latency report", L"See the log file for the error.");
+                    break;
+                }
+
+                show_notification(L"Latency report saved", reportFile.wstring());
+                break;
+            }
+
             default:
                 std::unreachable();
             }
@@ -313,9 +328,11 @@ void reregister_hot_keys()
 
     const auto [toggleOnOffKey, toggleOnOffModifier] = get_config().toggleOnOffHotkey;
     const auto [getProgramNameKey, getProgramNameModifier] = get_config().getProgramNameHotkey;
+    const auto [dumpLatencyReportKey, dumpLatencyReportModifier] = get_config().dumpLatencyReportHotkey;
     std::vector<std::tuple<EHotKeyType, EKey, EModifierKey>> hotKeys{
         { EHotKeyType::TOGGLE_ON_OFF, toggleOnOffKey, toggleOnOffModifier },
-        { EHotKeyType::GET_PROGRAM_NAME, getProgramNameKey, getProgramNameModifier }
+        { EHotKeyType::GET_PROGRAM_NAME, getProgramNameKey, getProgramNameModifier },
+        { EHotKeyType::DUMP_LATENCY_REPORT, dumpLatencyReportKey, dumpLatencyReportModifier }
     };
 
     hot_keys.clear();
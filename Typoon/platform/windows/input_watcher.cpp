@@ -146,7 +146,7 @@ std::optional<LRESULT> input_proc([[maybe_unused]] HWND hWnd, UINT msg, [[maybe_
                     }
                 }
 
-                character = alphabet_to_hangeul({ &character, 1 })[0];
+                alphabet_to_hangeul({ &character, 1 }, { &character, 1 });
             }
         }
 
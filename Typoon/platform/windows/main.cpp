@@ -1,4 +1,5 @@
 #include <Windows.h>
+#include <shellapi.h>
 
 #include "../../low_level/clipboard.h"
 #include "../../low_level/crash_handler.h"
@@ -9,6 +10,7 @@
 #include "../../low_level/window_focus.h"
 
 #include "../../common/common.h"
+#include "../../input_multicast/input_trace.h"
 #include "../../match/trigger_trees_per_program.h"
 #include "../../parse/parse_match.h"
 #include "../../utils/config.h"
@@ -17,6 +19,30 @@
 #include "wnd_proc.h"
 
 
+// `--capture-input [file]` records every input to replay it later, see `input_trace.h`. Empty if not given.
+std::filesystem::path get_input_capture_file()
+{
+    int argc = 0;
+    LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+    if (!argv)
+    {
+        return {};
+    }
+
+    std::filesystem::path captureFile;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::wstring_view{ argv[i] } == L"--capture-input")
+        {
+            captureFile = i + 1 < argc ? std::filesystem::path{ argv[i + 1] } : get_app_data_path() / "input_trace.bin";
+            break;
+        }
+    }
+    LocalFree(argv);
+    return captureFile;
+}
+
+
 int wWinMain(HINSTANCE hInstance, [[maybe_unused]] HINSTANCE hPrevInstance, [[maybe_unused]] LPWSTR cmdLine, [[maybe_unused]] int cmdShow)
 {
     initialize_crash_handler();
@@ -24,7 +50,7 @@ int wWinMain(HINSTANCE hInstance, [[maybe_unused]] HINSTANCE hPrevInstance, [[ma
 #ifdef _DEBUG
     logger.AddOutput(std::wcout);
 #endif
-    logger.AddOutput(get_log_file_path());
+    logger.AddBinaryOutput(get_log_file_path());
 
     // Prevent multiple instances
     CreateMutex(nullptr, false, L"Typoon_{91CC86BD-3107-4BFB-88E2-0A9A1280AB4A}");
@@ -70,6 +96,12 @@ int wWinMain(HINSTANCE hInstance, [[maybe_unused]] HINSTANCE hPrevInstance, [[ma
 
     show_tray_icon(std::make_tuple(hInstance, window));
 
+    if (const std::filesystem::path captureFile = get_input_capture_file();
+        !captureFile.empty())
+    {
+        start_input_capture(captureFile);
+    }
+
     read_config_file(get_config_file_path());
     setup_trigger_trees(get_config().matchFilePath);
     update_trigger_tree_program_overrides(get_config().programOverrides);
@@ -106,7 +138,10 @@ int wWinMain(HINSTANCE hInstance, [[maybe_unused]] HINSTANCE hPrevInstance, [[ma
             if (prevMatchFilePath != config.matchFilePath)
             {
                 prevMatchFilePath = config.matchFilePath;
-                get_trigger_tree(DEFAULT_PROGRAM_NAME)->ReconstructWith(config.matchFilePath);
+                TriggerTree* defaultTriggerTree = get_trigger_tree(DEFAULT_PROGRAM_NAME);
+                defaultTriggerTree->ReconstructWith(config.matchFilePath);
+                // The files to watch are changed along with the match file.
+                defaultTriggerTree->ThenAfterConstruction(lambdaAfterTreeReconstruct);
             }
 
             if (prevCursorPlaceholder != config.cursorPlaceholder)
@@ -189,6 +224,7 @@ int wWinMain(HINSTANCE hInstance, [[maybe_unused]] HINSTANCE hPrevInstance, [[ma
 
     turn_off();
 
+    stop_input_capture();
     teardown_trigger_trees();
     end_hot_key_watcher();
     remove_tray_icon();
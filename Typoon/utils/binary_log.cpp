@@ -0,0 +1,213 @@
+#include "binary_log.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <unordered_map>
+
+
+constexpr char BINARY_LOG_MAGIC[4]{ 'T', 'Y', 'L', 'G' };
+// Bump whenever the layout of the records or the arguments changes.
+constexpr unsigned int BINARY_LOG_VERSION = 1;
+// A new session is started once the current one is larger.
+constexpr unsigned long long BINARY_LOG_SESSION_SIZE = 256 * 1024;
+
+/// A session is the magic then the version. Each record after it starts with its kind, and its fields follow in this order.
+/// SITE: u32 site id, u32 line, u16 length of the file name, then the file name.
+/// LOG: u32 site id, u8 level, i64 nanoseconds since the epoch, u32 length of the arguments, then the serialized arguments.
+enum class EBinaryLogRecord : unsigned char
+{
+    SITE = 1,
+    LOG = 2,
+};
+
+
+template<typename T>
+void append_bytes(std::string& buffer, const T& value)
+{
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+
+BinaryLogWriter::BinaryLogWriter(const std::filesystem::path& file)
+    : mOfs(file, std::ios::binary | std::ios::app)
+{
+    std::error_code errorCode;
+    mFileSize = std::filesystem::file_size(file, errorCode);
+    if (errorCode)
+    {
+        mFileSize = 0;
+    }
+    startSession();
+}
+
+
+void BinaryLogWriter::startSession()
+{
+    mOfs.write(BINARY_LOG_MAGIC, sizeof(BINARY_LOG_MAGIC));
+    mOfs.write(reinterpret_cast<const char*>(&BINARY_LOG_VERSION), sizeof(BINARY_LOG_VERSION));
+    mSessionStart = mFileSize;
+    mFileSize += sizeof(BINARY_LOG_MAGIC) + sizeof(BINARY_LOG_VERSION);
+    mSiteIds.clear();
+}
+
+
+void BinaryLogWriter::Write(const LogRecord& record)
+{
+    if (mFileSize - mSessionStart >= BINARY_LOG_SESSION_SIZE)
+    {
+        startSession();
+    }
+
+    mBuffer.clear();
+
+    const auto [it, isNewSite] = mSiteIds.try_emplace({ record.file, record.line }, static_cast<unsigned int>(mSiteIds.size()));
+    const unsigned int siteId = it->second;
+    if (isNewSite)
+    {
+        const std::string_view file = record.file ? record.file : "";
+        mBuffer.push_back(static_cast<char>(EBinaryLogRecord::SITE));
+        append_bytes(mBuffer, siteId);
+        append_bytes(mBuffer, record.line);
+        append_bytes(mBuffer, static_cast<unsigned short>(std::min<size_t>(file.size(), 0xFFFF)));
+        mBuffer.append(file.substr(0, 0xFFFF));
+    }
+
+    mBuffer.push_back(static_cast<char>(EBinaryLogRecord::LOG));
+    append_bytes(mBuffer, siteId);
+    append_bytes(mBuffer, static_cast<unsigned char>(record.logLevel.logLevel));
+    append_bytes(mBuffer, static_cast<long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(record.time.time_since_epoch()).count()));
+    const size_t argumentsLengthOffset = mBuffer.size();
+    append_bytes(mBuffer, 0U);
+    record.arguments.Serialize(mBuffer);
+    const auto argumentsLength = static_cast<unsigned int>(mBuffer.size() - argumentsLengthOffset - sizeof(unsigned int));
+    std::memcpy(mBuffer.data() + argumentsLengthOffset, &argumentsLength, sizeof(argumentsLength));
+
+    mOfs.write(mBuffer.data(), static_cast<std::streamsize>(mBuffer.size()));
+    mFileSize += mBuffer.size();
+}
+
+
+void BinaryLogWriter::Flush()
+{
+    mOfs.flush();
+}
+
+
+template<typename FEntry, typename FSession>
+bool parse_binary_log(std::span<const std::byte> data, FEntry&& onEntry, FSession&& onSession)
+{
+    const auto lambdaIsSessionAt = [data](size_t offset)
+        {
+            return data.size() - offset >= sizeof(BINARY_LOG_MAGIC) + sizeof(BINARY_LOG_VERSION) &&
+                std::memcmp(data.data() + offset, BINARY_LOG_MAGIC, sizeof(BINARY_LOG_MAGIC)) == 0;
+        };
+    if (data.empty() || !lambdaIsSessionAt(0))
+    {
+        return false;
+    }
+
+    std::unordered_map<unsigned int, std::pair<std::string_view, unsigned int>> sites;
+    size_t cursor = 0;
+    bool isSessionValid = false;
+    // Returns false if the record doesn't fit in the data.
+    const auto lambdaRead = [data, &cursor]<typename T>(T& out)
+        {
+            if (data.size() - cursor < sizeof(T))
+            {
+                return false;
+            }
+            std::memcpy(&out, data.data() + cursor, sizeof(T));
+            cursor += sizeof(T);
+            return true;
+        };
+
+    while (cursor < data.size())
+    {
+        if (lambdaIsSessionAt(cursor))
+        {
+            unsigned int version = 0;
+            std::memcpy(&version, data.data() + cursor + sizeof(BINARY_LOG_MAGIC), sizeof(version));
+            isSessionValid = version == BINARY_LOG_VERSION;
+            sites.clear();
+            onSession(cursor);
+            cursor += sizeof(BINARY_LOG_MAGIC) + sizeof(version);
+            continue;
+        }
+
+        const size_t recordStart = cursor;
+        bool isRecordValid = isSessionValid;
+        unsigned char kind = 0;
+        isRecordValid = isRecordValid && lambdaRead(kind);
+        if (isRecordValid && kind == static_cast<unsigned char>(EBinaryLogRecord::SITE))
+        {
+            unsigned int siteId = 0;
+            unsigned int line = 0;
+            unsigned short fileLength = 0;
+            isRecordValid = lambdaRead(siteId) && lambdaRead(line) && lambdaRead(fileLength) && data.size() - cursor >= fileLength;
+            if (isRecordValid)
+            {
+                sites[siteId] = { std::string_view{ reinterpret_cast<const char*>(data.data() + cursor), fileLength }, line };
+                cursor += fileLength;
+            }
+        }
+        else if (isRecordValid && kind == static_cast<unsigned char>(EBinaryLogRecord::LOG))
+        {
+            unsigned int siteId = 0;
+            unsigned char logLevel = 0;
+            long long nanoseconds = 0;
+            unsigned int argumentsLength = 0;
+            isRecordValid = lambdaRead(siteId) && lambdaRead(logLevel) && lambdaRead(nanoseconds) && lambdaRead(argumentsLength) &&
+                data.size() - cursor >= argumentsLength && sites.contains(siteId) &&
+                logLevel > static_cast<unsigned char>(LogLevel::ELogLevel::MIN) && logLevel < static_cast<unsigned char>(LogLevel::ELogLevel::MAX);
+            if (isRecordValid)
+            {
+                const auto& [file, line] = sites[siteId];
+                onEntry({
+                    .time = std::chrono::system_clock::time_point{ std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds{ nanoseconds }) },
+                    .logLevel = { static_cast<LogLevel::ELogLevel>(logLevel) },
+                    .file = file,
+                    .line = line,
+                    .arguments = data.subspan(cursor, argumentsLength),
+                });
+                cursor += argumentsLength;
+            }
+        }
+        else
+        {
+            isRecordValid = false;
+        }
+
+        if (!isRecordValid)
+        {
+            // Skip to the next session, which starts with the magic.
+            const auto* next = std::search(data.data() + recordStart + 1, data.data() + data.size(),
+                reinterpret_cast<const std::byte*>(BINARY_LOG_MAGIC), reinterpret_cast<const std::byte*>(BINARY_LOG_MAGIC) + sizeof(BINARY_LOG_MAGIC));
+            cursor = static_cast<size_t>(next - data.data());
+            isSessionValid = false;
+        }
+    }
+    return true;
+}
+
+
+bool read_binary_log(std::span<const std::byte> data, const std::function<void(const BinaryLogEntry& entry)>& onEntry)
+{
+    return parse_binary_log(data, onEntry, [](size_t) {});
+}
+
+
+bool read_binary_log(const std::filesystem::path& file, const std::function<void(const BinaryLogEntry& entry)>& onEntry)
+{
+    std::ifstream ifs{ file, std::ios::binary };
+    const std::vector<char> data{ std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>() };
+    return read_binary_log(std::as_bytes(std::span{ data }), onEntry);
+}
+
+
+std::vector<size_t> find_binary_log_sessions(std::span<const std::byte> data)
+{
+    std::vector<size_t> sessions;
+    parse_binary_log(data, [](const BinaryLogEntry&) {}, [&sessions](size_t offset) { sessions.push_back(offset); });
+    return sessions;
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "logger.h"
+
+
+// The logs as they are in the queue of the logger, without being formatted.
+// Each process appends a session which starts with the magic, and a new one is started every so often,
+// so that a reader can start from any of them, e.g. to read only the end of a file.
+// The site of each log, its file and line, is written once per session, and the logs refer to it by its id.
+
+struct BinaryLogEntry
+{
+    std::chrono::system_clock::time_point time;
+    LogLevel logLevel;
+    std::string_view file;
+    unsigned int line = 0;
+    std::span<const std::byte> arguments;  // Format them with `append_log_arguments`.
+};
+
+
+class BinaryLogWriter
+{
+public:
+    // Appends to the file if it exists.
+    explicit BinaryLogWriter(const std::filesystem::path& file);
+
+    BinaryLogWriter(const BinaryLogWriter& other) = delete;
+    BinaryLogWriter(BinaryLogWriter&& other) noexcept = delete;
+    BinaryLogWriter& operator=(const BinaryLogWriter& other) = delete;
+    BinaryLogWriter& operator=(BinaryLogWriter&& other) noexcept = delete;
+
+    void Write(const LogRecord& record);
+    void Flush();
+
+    [[nodiscard]] bool IsGood() const { return mOfs.good(); }
+    // Including what was in the file before.
+    [[nodiscard]] unsigned long long GetFileSize() const { return mFileSize; }
+
+private:
+    void startSession();
+
+    std::ofstream mOfs;
+    unsigned long long mFileSize = 0;
+    unsigned long long mSessionStart = 0;
+    std::map<std::pair<const char*, unsigned int>, unsigned int> mSiteIds;
+    std::string mBuffer;
+};
+
+
+// Calls `onEntry` with each log in the order they were written. Returns false if `data` isn't a binary log.
+// A broken record, e.g. cut by a crash while writing, skips the rest of its session.
+bool read_binary_log(std::span<const std::byte> data, const std::function<void(const BinaryLogEntry& entry)>& onEntry);
+bool read_binary_log(const std::filesystem::path& file, const std::function<void(const BinaryLogEntry& entry)>& onEntry);
+
+// The offsets of the sessions in `data`, in order. Empty if it isn't a binary log.
+std::vector<size_t> find_binary_log_sessions(std::span<const std::byte> data);
@@ -0,0 +1,45 @@
+#include "completion.h"
+
+
+void Completion::Start()
+{
+    std::lock_guard lock{ mMutex };
+    mIsFinished.store(false);
+}
+
+
+void Completion::Finish()
+{
+    std::vector<std::function<void()>> continuations;
+    {
+        std::lock_guard lock{ mMutex };
+        mIsFinished.store(true);
+        std::swap(continuations, mContinuations);
+    }
+    mIsFinished.notify_all();
+
+    for (const std::function<void()>& continuation : continuations)
+    {
+        continuation();
+    }
+}
+
+
+void Completion::Wait() const
+{
+    mIsFinished.wait(false);
+}
+
+
+void Completion::Then(std::function<void()> onFinish)
+{
+    {
+        std::lock_guard lock{ mMutex };
+        if (!mIsFinished.load())
+        {
+            mContinuations.emplace_back(std::move(onFinish));
+            return;
+        }
+    }
+    onFinish();
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+
+// Signals that a piece of work running in another thread has finished.
+// It can be waited for without polling, or work can be chained onto it.
+// Can be restarted, then the waiting ones and the chained work wait for the next finish.
+class Completion
+{
+public:
+    void Start();
+    // Runs the chained work in the calling thread.
+    void Finish();
+    void Wait() const;
+    // Runs `onFinish` right away if finished, or in the thread finishing it otherwise.
+    void Then(std::function<void()> onFinish);
+    [[nodiscard]] bool IsFinished() const { return mIsFinished.load(); }
+
+private:
+    std::atomic<bool> mIsFinished = true;
+    std::mutex mMutex;
+    std::vector<std::function<void()>> mContinuations;
+};
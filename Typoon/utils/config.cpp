@@ -63,9 +63,16 @@ JSON5_CLASS(ProgramOverrideForParse, programs, disable, match_file_path, include
 
 struct ConfigForParse
 {
+    enum class EMatchEngine
+    {
+        agents,
+        automaton,
+    };
+
     std::filesystem::path match_file_path = "match/matches.json5";
     int max_backspace_count = 5;
     std::string cursor_placeholder = "|_|";
+    EMatchEngine match_engine = EMatchEngine::agents;
 
     bool notify_config_load = true;
     bool notify_match_load = true;
@@ -73,6 +80,7 @@ struct ConfigForParse
 
     HotKeyForParse hotkey_toggle_on_off = { .ctrl = true, .shift = true, .alt = true, .key = EKey::S };
     HotKeyForParse hotkey_get_program_name = { .ctrl = true, .shift = true, .alt = true, .key = EKey::D };
+    HotKeyForParse hotkey_dump_latency_report = { .ctrl = true, .shift = true, .alt = true, .key = EKey::L };
 
     std::vector<ProgramOverrideForParse> program_overrides;
     
@@ -82,11 +90,13 @@ struct ConfigForParse
             std::move(match_file_path),
             max_backspace_count,
             { cursor_placeholder.begin(), cursor_placeholder.end() },
+            static_cast<Config::EMatchEngine>(match_engine),
             notify_config_load,
             notify_match_load,
             notify_on_off,
             { hotkey_toggle_on_off.key, get_combined_modifier(hotkey_toggle_on_off) },
-            { hotkey_get_program_name.key, get_combined_modifier(hotkey_get_program_name) }
+            { hotkey_get_program_name.key, get_combined_modifier(hotkey_get_program_name) },
+            { hotkey_dump_latency_report.key, get_combined_modifier(hotkey_dump_latency_report) }
         };
 
         std::transform(std::move_iterator{ program_overrides.begin() }, std::move_iterator{ program_overrides.end() }, std::back_inserter(config.programOverrides),
@@ -100,7 +110,8 @@ struct ConfigForParse
 };
 
 
-JSON5_CLASS(ConfigForParse, match_file_path, max_backspace_count, cursor_placeholder, notify_config_load, notify_match_load, notify_on_off, hotkey_toggle_on_off, hotkey_get_program_name, program_overrides)
+JSON5_ENUM(ConfigForParse::EMatchEngine, agents, automaton)
+JSON5_CLASS(ConfigForParse, match_file_path, max_backspace_count, cursor_placeholder, match_engine, notify_config_load, notify_match_load, notify_on_off, hotkey_toggle_on_off, hotkey_get_program_name, hotkey_dump_latency_report, program_overrides)
 
 Config config;
 
@@ -18,9 +18,17 @@ struct ProgramOverride
 
 struct Config
 {
+    enum class EMatchEngine
+    {
+        AGENTS,
+        AUTOMATON,
+    };
+
+
     std::filesystem::path matchFilePath;
     int maxBackspaceCount;
     std::wstring cursorPlaceholder;
+    EMatchEngine matchEngine;
 
     bool notifyConfigLoad;
     bool notifyMatchLoad;
@@ -28,6 +36,7 @@ struct Config
 
     std::pair<EKey, EModifierKey> toggleOnOffHotkey;
     std::pair<EKey, EModifierKey> getProgramNameHotkey;
+    std::pair<EKey, EModifierKey> dumpLatencyReportHotkey;
 
     std::vector<ProgramOverride> programOverrides;
 };
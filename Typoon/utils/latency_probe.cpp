@@ -0,0 +1,176 @@
+#include "latency_probe.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <format>
+#include <fstream>
+
+#include "logger.h"
+
+
+/// The buckets are exact below 16ns, then split each power of 2 into 8.
+constexpr int EXACT_BUCKET_COUNT = 16;
+constexpr int SUB_BUCKET_BITS = 3;
+constexpr int LATENCY_BUCKET_COUNT = EXACT_BUCKET_COUNT + (64 - std::bit_width(static_cast<unsigned int>(EXACT_BUCKET_COUNT - 1))) * (1 << SUB_BUCKET_BITS);
+constexpr auto LATENCY_PROBE_COUNT = static_cast<size_t>(ELatencyProbe::COUNT);
+
+constexpr std::string_view LATENCY_PROBE_NAMES[]{
+    "ImmSimulator::AddLetter",
+    "multicast_input",
+    "TriggerTree::OnInput",
+    "TriggerTree::replaceString",
+    "send_fake_inputs",
+    "Input to injection",
+};
+static_assert(std::size(LATENCY_PROBE_NAMES) == LATENCY_PROBE_COUNT);
+
+
+constexpr int get_latency_bucket(unsigned long long nanoseconds)
+{
+    if (nanoseconds < EXACT_BUCKET_COUNT)
+    {
+        return static_cast<int>(nanoseconds);
+    }
+    const int exponent = std::bit_width(nanoseconds) - 1;
+    const auto subBucket = static_cast<int>(nanoseconds >> (exponent - SUB_BUCKET_BITS)) & ((1 << SUB_BUCKET_BITS) - 1);
+    return EXACT_BUCKET_COUNT + (exponent - std::bit_width(static_cast<unsigned int>(EXACT_BUCKET_COUNT - 1))) * (1 << SUB_BUCKET_BITS) + subBucket;
+}
+
+// The largest latency that falls in the bucket.
+constexpr unsigned long long get_latency_bucket_upper_bound(int bucket)
+{
+    if (bucket < EXACT_BUCKET_COUNT)
+    {
+        return static_cast<unsigned long long>(bucket);
+    }
+    const int exponent = (bucket - EXACT_BUCKET_COUNT) / (1 << SUB_BUCKET_BITS) + std::bit_width(static_cast<unsigned int>(EXACT_BUCKET_COUNT - 1));
+    const auto subBucket = static_cast<unsigned long long>((bucket - EXACT_BUCKET_COUNT) % (1 << SUB_BUCKET_BITS));
+    return (((1ULL << SUB_BUCKET_BITS) + subBucket + 1) << (exponent - SUB_BUCKET_BITS)) - 1;
+}
+
+static_assert(get_latency_bucket(15) == 15 && get_latency_bucket(16) == 16 && get_latency_bucket(17) == 16 && get_latency_bucket(18) == 17);
+static_assert(get_latency_bucket(~0ULL) == LATENCY_BUCKET_COUNT - 1);
+static_assert(get_latency_bucket_upper_bound(16) == 17 && get_latency_bucket_upper_bound(get_latency_bucket(1000)) >= 1000);
+
+
+/// Written only by the thread owning it, read by anyone, hence the relaxed atomics.
+/// Never freed once registered, there are only a handful of threads.
+struct LatencyHistograms
+{
+    std::array<std::array<std::atomic<unsigned long long>, LATENCY_BUCKET_COUNT>, LATENCY_PROBE_COUNT> counts{};
+    std::array<std::atomic<unsigned long long>, LATENCY_PROBE_COUNT> maxes{};
+    LatencyHistograms* next = nullptr;
+};
+
+std::atomic<LatencyHistograms*> latency_histograms_head = nullptr;
+thread_local LatencyHistograms* thread_latency_histograms = nullptr;
+thread_local std::chrono::steady_clock::time_point thread_input_start{};
+
+
+LatencyHistograms& get_thread_latency_histograms()
+{
+    if (!thread_latency_histograms)
+    {
+        auto* histograms = new LatencyHistograms{};
+        histograms->next = latency_histograms_head.load(std::memory_order_relaxed);
+        while (!latency_histograms_head.compare_exchange_weak(histograms->next, histograms, std::memory_order_release, std::memory_order_relaxed))
+        {}
+        thread_latency_histograms = histograms;
+    }
+    return *thread_latency_histograms;
+}
+
+
+void record_latency(ELatencyProbe probe, std::chrono::steady_clock::duration latency)
+{
+    const auto nanoseconds = static_cast<unsigned long long>(std::max(std::chrono::nanoseconds{ latency }, std::chrono::nanoseconds{ 0 }).count());
+    LatencyHistograms& histograms = get_thread_latency_histograms();
+    const auto probeIndex = static_cast<size_t>(probe);
+
+    // A single writer, so no need for the read-modify-write instructions.
+    std::atomic<unsigned long long>& count = histograms.counts[probeIndex][get_latency_bucket(nanoseconds)];
+    count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (std::atomic<unsigned long long>& max = histograms.maxes[probeIndex];
+        nanoseconds > max.load(std::memory_order_relaxed))
+    {
+        max.store(nanoseconds, std::memory_order_relaxed);
+    }
+}
+
+
+void mark_input_start(std::chrono::steady_clock::time_point time)
+{
+    thread_input_start = time;
+}
+
+
+void mark_injection_end()
+{
+    if (thread_input_start != std::chrono::steady_clock::time_point{})
+    {
+        record_latency(ELatencyProbe::INPUT_TO_INJECTION, std::chrono::steady_clock::now() - thread_input_start);
+        // Once per input, the rest of the replacements for it are not what the user waited for.
+        thread_input_start = {};
+    }
+}
+
+
+std::string get_latency_report()
+{
+    std::array<std::array<unsigned long long, LATENCY_BUCKET_COUNT>, LATENCY_PROBE_COUNT> counts{};
+    std::array<unsigned long long, LATENCY_PROBE_COUNT> maxes{};
+    for (const LatencyHistograms* histograms = latency_histograms_head.load(std::memory_order_acquire); histograms; histograms = histograms->next)
+    {
+        for (size_t probe = 0; probe < LATENCY_PROBE_COUNT; probe++)
+        {
+            for (int bucket = 0; bucket < LATENCY_BUCKET_COUNT; bucket++)
+            {
+                counts[probe][bucket] += histograms->counts[probe][bucket].load(std::memory_order_relaxed);
+            }
+            maxes[probe] = std::max(maxes[probe], histograms->maxes[probe].load(std::memory_order_relaxed));
+        }
+    }
+
+    std::string report = std::format("{:<28}{:>12}{:>12}{:>12}{:>12}{:>12}\n", "Latency (us)", "Count", "p50", "p99", "p99.9", "Max");
+    for (size_t probe = 0; probe < LATENCY_PROBE_COUNT; probe++)
+    {
+        unsigned long long total = 0;
+        for (const unsigned long long count : counts[probe])
+        {
+            total += count;
+        }
+
+        const auto lambdaPercentile = [&counts, probe, total](double percentile)
+            {
+                const auto rank = static_cast<unsigned long long>(percentile / 100 * static_cast<double>(total));
+                unsigned long long seen = 0;
+                for (int bucket = 0; bucket < LATENCY_BUCKET_COUNT; bucket++)
+                {
+                    seen += counts[probe][bucket];
+                    if (seen > rank)
+                    {
+                        return static_cast<double>(get_latency_bucket_upper_bound(bucket)) / 1000;
+                    }
+                }
+                return 0.0;
+            };
+        report += std::format("{:<28}{:>12}{:>12.1f}{:>12.1f}{:>12.1f}{:>12.1f}\n", LATENCY_PROBE_NAMES[probe], total,
+            lambdaPercentile(50), lambdaPercentile(99), lambdaPercentile(99.9), static_cast<double>(maxes[probe]) / 1000);
+    }
+    return report;
+}
+
+
+bool dump_latency_report(const std::filesystem::path& file)
+{
+    std::ofstream ofs{ file, std::ios::trunc };
+    ofs << get_latency_report();
+    if (!ofs)
+    {
+        logger.Log(ELogLevel::ERROR, "Failed to write the latency report:", file);
+        return false;
+    }
+    return true;
+}
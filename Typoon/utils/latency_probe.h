@@ -0,0 +1,55 @@
+#pragma once
+#include <chrono>
+#include <filesystem>
+#include <string>
+
+
+// Always-on timing of the input path, to get the latencies from the users' machines without a profiler.
+// Each thread records into its own histograms, so recording never waits for anything.
+
+enum class ELatencyProbe
+{
+    IMM_ADD_LETTER,
+    MULTICAST_INPUT,
+    TRIGGER_TREE_ON_INPUT,
+    TRIGGER_TREE_REPLACE_STRING,
+    SEND_FAKE_INPUTS,
+    // From a letter coming into the IMM to the replacement for it sent, in the same thread.
+    INPUT_TO_INJECTION,
+
+    COUNT,
+};
+
+
+void record_latency(ELatencyProbe probe, std::chrono::steady_clock::duration latency);
+
+// Marks the start of `ELatencyProbe::INPUT_TO_INJECTION` for the calling thread.
+void mark_input_start(std::chrono::steady_clock::time_point time);
+// Records `ELatencyProbe::INPUT_TO_INJECTION` if an input was marked in the calling thread.
+void mark_injection_end();
+
+
+// Records the lifetime of the scope.
+class [[nodiscard]] LatencyProbe
+{
+public:
+    explicit LatencyProbe(ELatencyProbe probe) : mProbe(probe), mStart(std::chrono::steady_clock::now()) {}
+    ~LatencyProbe() { record_latency(mProbe, std::chrono::steady_clock::now() - mStart); }
+    LatencyProbe(const LatencyProbe& other) = delete;
+    LatencyProbe(LatencyProbe&& other) noexcept = delete;
+    LatencyProbe& operator=(const LatencyProbe& other) = delete;
+    LatencyProbe& operator=(LatencyProbe&& other) noexcept = delete;
+
+    [[nodiscard]] std::chrono::steady_clock::time_point GetStart() const { return mStart; }
+
+private:
+    ELatencyProbe mProbe;
+    std::chrono::steady_clock::time_point mStart;
+};
+
+
+// The count, p50, p99, p99.9 and the max of every probe since the start, merged from all the threads.
+// The percentiles are the upper bounds of the buckets they fall in, which are at most 12.5% off.
+[[nodiscard]] std::string get_latency_report();
+
+bool dump_latency_report(const std::filesystem::path& file);
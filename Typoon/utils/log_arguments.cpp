@@ -0,0 +1,253 @@
+#include "log_arguments.h"
+
+#include <algorithm>
+#include <limits>
+
+
+void LogArguments::AppendWString(std::wstring_view string)
+{
+    if (string.size() > std::numeric_limits<unsigned short>::max() ||
+        mLength + 1 + sizeof(unsigned short) + string.size() * sizeof(wchar_t) > CAPACITY)
+    {
+        appendHeapWString(std::wstring{ string });
+        return;
+    }
+
+    const auto length = static_cast<unsigned short>(string.size());
+    mData[mLength] = static_cast<std::byte>(EType::WSTRING);
+    std::memcpy(mData + mLength + 1, &length, sizeof(length));
+    std::memcpy(mData + mLength + 1 + sizeof(length), string.data(), string.size() * sizeof(wchar_t));
+    mLength += static_cast<unsigned short>(1 + sizeof(length) + string.size() * sizeof(wchar_t));
+}
+
+
+void LogArguments::AppendString(std::string_view string)
+{
+    if (string.size() > std::numeric_limits<unsigned short>::max() ||
+        mLength + 1 + sizeof(unsigned short) + string.size() > CAPACITY)
+    {
+        appendHeapWString(std::wstring{ string.begin(), string.end() });
+        return;
+    }
+
+    const auto length = static_cast<unsigned short>(string.size());
+    mData[mLength] = static_cast<std::byte>(EType::STRING);
+    std::memcpy(mData + mLength + 1, &length, sizeof(length));
+    std::memcpy(mData + mLength + 1 + sizeof(length), string.data(), string.size());
+    mLength += static_cast<unsigned short>(1 + sizeof(length) + string.size());
+}
+
+
+void LogArguments::appendHeapWString(std::wstring&& string)
+{
+    if (mLength + 1 + sizeof(std::wstring*) > CAPACITY)
+    {
+        mIsTruncated = true;
+        return;
+    }
+    appendValue(EType::HEAP_WSTRING, new std::wstring{ std::move(string) });
+}
+
+
+// Calls `visit` with the type and the start of the value of each argument, and their whole size.
+// Returns false if an argument doesn't fit in `arguments`, or its type is unknown.
+template<typename F>
+bool for_each_log_argument(std::span<const std::byte> arguments, F&& visit)
+{
+    for (size_t offset = 0; offset < arguments.size();)
+    {
+        const auto type = static_cast<LogArguments::EType>(arguments[offset]);
+        const std::byte* value = arguments.data() + offset + 1;
+        const size_t remaining = arguments.size() - offset - 1;
+
+        size_t valueSize = 0;
+        unsigned short stringLength = 0;
+        switch (type)
+        {
+        case LogArguments::EType::BOOL:
+            valueSize = sizeof(bool);
+            break;
+        case LogArguments::EType::INT:
+        case LogArguments::EType::UINT:
+        case LogArguments::EType::DOUBLE:
+            valueSize = 8;
+            break;
+        case LogArguments::EType::WSTRING:
+        case LogArguments::EType::STRING:
+            if (remaining < sizeof(stringLength))
+            {
+                return false;
+            }
+            std::memcpy(&stringLength, value, sizeof(stringLength));
+            valueSize = sizeof(stringLength) + stringLength * (type == LogArguments::EType::WSTRING ? sizeof(wchar_t) : 1);
+            break;
+        case LogArguments::EType::HEAP_WSTRING:
+            valueSize = sizeof(std::wstring*);
+            break;
+        case LogArguments::EType::TRUNCATED:
+            break;
+        default:
+            return false;
+        }
+
+        if (valueSize > remaining)
+        {
+            return false;
+        }
+        visit(type, value, 1 + valueSize);
+        offset += 1 + valueSize;
+    }
+    return true;
+}
+
+
+void append_log_argument(LogArguments::EType type, const std::byte* value, std::wstring& line)
+{
+    const auto lambdaRead = [value]<typename T>(T& out) { std::memcpy(&out, value, sizeof(T)); };
+    switch (type)
+    {
+    case LogArguments::EType::BOOL:
+    {
+        bool b;
+        lambdaRead(b);
+        line.append(b ? L"true" : L"false");
+        break;
+    }
+    case LogArguments::EType::INT:
+    {
+        long long i;
+        lambdaRead(i);
+        line.append(std::to_wstring(i));
+        break;
+    }
+    case LogArguments::EType::UINT:
+    {
+        unsigned long long u;
+        lambdaRead(u);
+        line.append(std::to_wstring(u));
+        break;
+    }
+    case LogArguments::EType::DOUBLE:
+    {
+        double d;
+        lambdaRead(d);
+        line.append(std::to_wstring(d));
+        break;
+    }
+    case LogArguments::EType::WSTRING:
+    {
+        unsigned short length;
+        lambdaRead(length);
+        const size_t offset = line.size();
+        line.resize(offset + length);
+        std::memcpy(line.data() + offset, value + sizeof(length), length * sizeof(wchar_t));
+        break;
+    }
+    case LogArguments::EType::STRING:
+    {
+        unsigned short length;
+        lambdaRead(length);
+        const auto* chars = reinterpret_cast<const char*>(value + sizeof(length));
+        line.append(chars, chars + length);
+        break;
+    }
+    case LogArguments::EType::HEAP_WSTRING:
+    {
+        const std::wstring* string;
+        lambdaRead(string);
+        line.append(*string);
+        break;
+    }
+    case LogArguments::EType::TRUNCATED:
+        line.append(L"...");
+        break;
+    }
+}
+
+
+void LogArguments::AppendTo(std::wstring& line) const
+{
+    bool isFirst = true;
+    for_each_log_argument({ mData, mLength }, [&line, &isFirst](EType type, const std::byte* value, size_t)
+        {
+            if (!isFirst)
+            {
+                line.push_back(L' ');
+            }
+            isFirst = false;
+            append_log_argument(type, value, line);
+        });
+
+    if (mIsTruncated)
+    {
+        line.append(isFirst ? L"..." : L" ...");
+    }
+}
+
+
+void LogArguments::Serialize(std::string& bytes) const
+{
+    for_each_log_argument({ mData, mLength }, [&bytes](EType type, const std::byte* value, size_t size)
+        {
+            if (type != EType::HEAP_WSTRING)
+            {
+                bytes.append(reinterpret_cast<const char*>(value) - 1, size);
+                return;
+            }
+
+            const std::wstring* string;
+            std::memcpy(&string, value, sizeof(string));
+            const auto length = static_cast<unsigned short>(std::min<size_t>(string->size(), std::numeric_limits<unsigned short>::max()));
+            bytes.push_back(static_cast<char>(EType::WSTRING));
+            bytes.append(reinterpret_cast<const char*>(&length), sizeof(length));
+            bytes.append(reinterpret_cast<const char*>(string->data()), length * sizeof(wchar_t));
+            if (length < string->size())
+            {
+                bytes.push_back(static_cast<char>(EType::TRUNCATED));
+            }
+        });
+
+    if (mIsTruncated)
+    {
+        bytes.push_back(static_cast<char>(EType::TRUNCATED));
+    }
+}
+
+
+void LogArguments::Release()
+{
+    for_each_log_argument({ mData, mLength }, [](EType type, const std::byte* value, size_t)
+        {
+            if (type == EType::HEAP_WSTRING)
+            {
+                std::wstring* string;
+                std::memcpy(&string, value, sizeof(string));
+                delete string;
+            }
+        });
+    mLength = 0;
+    mIsTruncated = false;
+}
+
+
+bool append_log_arguments(std::span<const std::byte> arguments, std::wstring& line)
+{
+    // Pointers in the stored arguments are from another process.
+    bool isFirst = true;
+    bool isValid = true;
+    const bool isWellFormed = for_each_log_argument(arguments, [&line, &isFirst, &isValid](LogArguments::EType type, const std::byte* value, size_t)
+        {
+            if (type == LogArguments::EType::HEAP_WSTRING)
+            {
+                isValid = false;
+                return;
+            }
+            if (!isFirst)
+            {
+                line.push_back(L' ');
+            }
+            isFirst = false;
+            append_log_argument(type, value, line);
+        });
+    return isWellFormed && isValid;
+}
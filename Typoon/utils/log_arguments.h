@@ -0,0 +1,191 @@
+#pragma once
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+
+namespace _impl
+{
+template<typename T>
+concept CanConstructWStringWith = requires(T t)
+{
+    std::wstring{ t };
+};
+
+template<typename T>
+concept CanConvertibleToWString = requires(T t)
+{
+    std::to_wstring(t);
+};
+
+template<typename T>
+concept CanConstructStringWith = requires(T t)
+{
+    std::string{ t };
+};
+
+template<typename T>
+concept CanConvertibleToString = requires(T t)
+{
+    std::to_string(t);
+};
+
+template<typename T>
+concept CanBeString = CanConstructWStringWith<T> || CanConvertibleToWString<T> || CanConstructStringWith<T> || CanConvertibleToString<T> || std::is_same_v<std::remove_cvref_t<T>, bool>;
+
+template<CanBeString T>
+std::wstring to_wstring(const T& t)
+{
+    if constexpr (std::is_same_v<std::remove_cvref_t<T>, bool>)
+    {
+        return t ? L"true" : L"false";
+    }
+    else if constexpr (CanConstructWStringWith<T>)
+    {
+        return std::wstring{ t };
+    }
+    else if constexpr (CanConvertibleToWString<T>)
+    {
+        return std::to_wstring(t);
+    }
+    else if constexpr (CanConstructStringWith<T>)
+    {
+        std::string s{ t };
+        return std::wstring{ s.begin(), s.end() };
+    }
+    else if constexpr (CanConvertibleToString<T>)
+    {
+        std::string s = std::to_string(t);
+        return std::wstring{ s.begin(), s.end() };
+    }
+    else
+    {
+        std::unreachable();
+    }
+}
+}
+
+
+// The arguments of a log, copied as they are with their types, so that the caller doesn't format them.
+// Strings too long to fit are moved to the heap, and the consumer has to `Release` them after use.
+class LogArguments
+{
+public:
+    enum class EType : unsigned char
+    {
+        BOOL,
+        INT,
+        UINT,
+        DOUBLE,
+        WSTRING,  // Length, then the letters.
+        STRING,  // Length, then the bytes, widened one by one when formatted, like `_impl::to_wstring`.
+        HEAP_WSTRING,  // Pointer to a `std::wstring` owned by the arguments.
+        TRUNCATED,  // Some arguments were left out after it. Only in the serialized arguments.
+    };
+
+    // So that a whole log record is 256 bytes.
+    static constexpr size_t CAPACITY = 224;
+
+    // Leaves the buffer uninitialized, it's read only up to `mLength`.
+    LogArguments() {}
+
+    template<_impl::CanBeString T>
+    void Append(const T& t);
+
+    void AppendWString(std::wstring_view string);
+    void AppendString(std::string_view string);
+
+    // The arguments separated by a space, the same as formatting each of them with `_impl::to_wstring`.
+    void AppendTo(std::wstring& line) const;
+
+    // Into bytes that can be stored, with the heap strings copied in. Read them with `append_log_arguments`.
+    void Serialize(std::string& bytes) const;
+
+    // Frees the heap strings, and clears the arguments.
+    void Release();
+
+    [[nodiscard]] bool IsEmpty() const { return mLength == 0; }
+
+private:
+    template<typename T>
+    void appendValue(EType type, const T& value);
+
+    void appendHeapWString(std::wstring&& string);
+
+    unsigned short mLength = 0;
+    // Some arguments were left out since there wasn't any room, not even for a pointer.
+    bool mIsTruncated = false;
+    std::byte mData[CAPACITY];
+};
+
+
+// Formats serialized arguments the same as `LogArguments::AppendTo`. Returns false if they're broken.
+bool append_log_arguments(std::span<const std::byte> arguments, std::wstring& line);
+
+
+template<_impl::CanBeString T>
+void LogArguments::Append(const T& t)
+{
+    using Type = std::remove_cvref_t<T>;
+    if constexpr (std::is_same_v<Type, bool>)
+    {
+        appendValue(EType::BOOL, t);
+    }
+    else if constexpr (std::is_same_v<Type, wchar_t>)
+    {
+        AppendWString({ &t, 1 });
+    }
+    else if constexpr (std::is_convertible_v<const T&, std::wstring_view>)
+    {
+        AppendWString(t);
+    }
+    else if constexpr (std::is_same_v<Type, std::filesystem::path>)
+    {
+        if constexpr (std::is_same_v<std::filesystem::path::value_type, wchar_t>)
+        {
+            AppendWString(t.native());
+        }
+        else
+        {
+            AppendString(t.native());
+        }
+    }
+    else if constexpr (std::is_integral_v<Type> && std::is_signed_v<Type>)
+    {
+        appendValue(EType::INT, static_cast<long long>(t));
+    }
+    else if constexpr (std::is_integral_v<Type>)
+    {
+        appendValue(EType::UINT, static_cast<unsigned long long>(t));
+    }
+    else if constexpr (std::is_floating_point_v<Type>)
+    {
+        appendValue(EType::DOUBLE, static_cast<double>(t));
+    }
+    else if constexpr (std::is_convertible_v<const T&, std::string_view>)
+    {
+        AppendString(t);
+    }
+    else
+    {
+        AppendWString(_impl::to_wstring(t));
+    }
+}
+
+template<typename T>
+void LogArguments::appendValue(EType type, const T& value)
+{
+    if (mLength + 1 + sizeof(T) > CAPACITY)
+    {
+        mIsTruncated = true;
+        return;
+    }
+    mData[mLength] = static_cast<std::byte>(type);
+    std::memcpy(mData + mLength + 1, &value, sizeof(T));
+    mLength += static_cast<unsigned short>(1 + sizeof(T));
+}
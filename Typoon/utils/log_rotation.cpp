@@ -0,0 +1,339 @@
+#include "log_rotation.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <ranges>
+#include <string>
+#include <utility>
+
+#include "../low_level/compression.h"
+
+
+constexpr char COMPRESSED_LOG_MAGIC[4]{ 'T', 'Y', 'L', 'Z' };
+constexpr unsigned int COMPRESSED_LOG_VERSION = 1;
+constexpr char COMPRESSED_LOG_EXTENSION[] = ".tylz";
+// A frame ends at the first session after this many bytes, so that tailing decompresses only a little.
+constexpr size_t COMPRESSED_LOG_FRAME_SIZE = 256 * 1024;
+
+
+RotatingBinaryLog::RotatingBinaryLog(std::filesystem::path file, const LogRotationOptions& options)
+    : mFile(std::move(file))
+    , mOptions(options)
+    , mBackgroundThread([this](const std::stop_token& stopToken)
+    {
+        std::unique_lock lock{ mMutex };
+        while (mCondition.wait(lock, stopToken, [this] { return mFinishedWorkCount != mRequestedWorkCount; }))
+        {
+            const unsigned int requestedWorkCount = mRequestedWorkCount;
+            lock.unlock();
+            compressSegments(stopToken);
+            pruneSegments();
+            lock.lock();
+            mFinishedWorkCount = requestedWorkCount;
+            mCondition.notify_all();
+        }
+    })
+{
+    // Only looks at the size and the time of the file, so that the startup isn't slowed down by the segments from before.
+    std::error_code errorCode;
+    const unsigned long long fileSize = std::filesystem::file_size(mFile, errorCode);
+    const bool isEmpty = errorCode || fileSize == 0;
+    const auto lastWriteTime = std::filesystem::last_write_time(mFile, errorCode);
+    if (!isEmpty && !errorCode &&
+        (fileSize >= mOptions.maxFileSize || std::filesystem::file_time_type::clock::now() - lastWriteTime >= mOptions.maxFileAge))
+    {
+        rotate();
+        return;
+    }
+
+    mWriter = std::make_unique<BinaryLogWriter>(mFile);
+    // When the file was started isn't known, so it may last up to twice as long.
+    mRotationTime = std::chrono::system_clock::now() + mOptions.maxFileAge;
+    mRotationSize = mOptions.maxFileSize;
+    requestBackgroundWork();
+}
+
+
+void RotatingBinaryLog::Write(const LogRecord& record)
+{
+    if (mWriter->GetFileSize() >= mRotationSize || record.time >= mRotationTime)
+    {
+        rotate();
+    }
+    mWriter->Write(record);
+}
+
+
+void RotatingBinaryLog::Flush()
+{
+    mWriter->Flush();
+}
+
+
+void RotatingBinaryLog::WaitForBackgroundWork()
+{
+    std::unique_lock lock{ mMutex };
+    const unsigned int requestedWorkCount = mRequestedWorkCount;
+    mCondition.wait(lock, [this, requestedWorkCount] { return mFinishedWorkCount >= requestedWorkCount; });
+}
+
+
+std::filesystem::path get_log_segment_path(const std::filesystem::path& file, long long seconds, const std::filesystem::path& extension)
+{
+    std::filesystem::path segment = file;
+    segment.replace_filename(file.stem());
+    segment += ".";
+    segment += std::to_string(seconds);
+    segment += extension;
+    return segment;
+}
+
+
+void RotatingBinaryLog::rotate()
+{
+    mWriter.reset();
+
+    const auto now = std::chrono::system_clock::now();
+    // The next free second, in case it was rotated twice in a second.
+    long long seconds = std::chrono::duration_cast<std::chrono::seconds>(now.time_since_epoch()).count();
+    std::error_code errorCode;
+    while (std::filesystem::exists(get_log_segment_path(mFile, seconds, mFile.extension()), errorCode) ||
+        std::filesystem::exists(get_log_segment_path(mFile, seconds, COMPRESSED_LOG_EXTENSION), errorCode))
+    {
+        seconds++;
+    }
+    std::filesystem::rename(mFile, get_log_segment_path(mFile, seconds, mFile.extension()), errorCode);
+
+    mWriter = std::make_unique<BinaryLogWriter>(mFile);
+    mRotationTime = now + mOptions.maxFileAge;
+    // Tried again after another `maxFileSize` if it couldn't be renamed, e.g. while something else has it open.
+    mRotationSize = mWriter->GetFileSize() + mOptions.maxFileSize;
+    requestBackgroundWork();
+}
+
+
+void RotatingBinaryLog::requestBackgroundWork()
+{
+    {
+        std::lock_guard lock{ mMutex };
+        mRequestedWorkCount++;
+    }
+    mCondition.notify_all();
+}
+
+
+// The segments of `file` with the time they were rotated at, the oldest first.
+// If a segment was compressed but not deleted yet, only the uncompressed one is.
+std::vector<std::pair<long long, std::filesystem::path>> find_log_segments_with_time(const std::filesystem::path& file)
+{
+    std::vector<std::pair<long long, std::filesystem::path>> segments;
+    std::error_code errorCode;
+    for (const auto& entry : std::filesystem::directory_iterator{ file.has_parent_path() ? file.parent_path() : ".", errorCode })
+    {
+        // e.g. "typoon" and ".1760000000" from "typoon.1760000000.tylz".
+        const std::filesystem::path& path = entry.path();
+        const std::filesystem::path name = path.stem();
+        const std::string number = name.extension().string();
+        if ((path.extension() != file.extension() && path.extension() != COMPRESSED_LOG_EXTENSION) ||
+            name.stem() != file.stem() || number.size() < 2)
+        {
+            continue;
+        }
+
+        long long seconds = 0;
+        const auto [end, error] = std::from_chars(number.data() + 1, number.data() + number.size(), seconds);
+        if (error == std::errc{} && end == number.data() + number.size())
+        {
+            segments.emplace_back(seconds, path);
+        }
+    }
+
+    // The uncompressed one first.
+    std::ranges::sort(segments, [](const auto& a, const auto& b)
+        {
+            return std::pair{ a.first, a.second.extension() == COMPRESSED_LOG_EXTENSION } < std::pair{ b.first, b.second.extension() == COMPRESSED_LOG_EXTENSION };
+        });
+    const auto duplicates = std::ranges::unique(segments, {}, &std::pair<long long, std::filesystem::path>::first);
+    segments.erase(duplicates.begin(), duplicates.end());
+    return segments;
+}
+
+
+std::vector<std::filesystem::path> find_log_segments(const std::filesystem::path& file)
+{
+    std::vector<std::filesystem::path> segments;
+    for (auto& segment : find_log_segments_with_time(file) | std::views::values)
+    {
+        segments.emplace_back(std::move(segment));
+    }
+    return segments;
+}
+
+
+void RotatingBinaryLog::compressSegments(const std::stop_token& stopToken) const
+{
+    for (const std::filesystem::path& segment : find_log_segments(mFile))
+    {
+        if (stopToken.stop_requested())
+        {
+            return;
+        }
+        if (segment.extension() == COMPRESSED_LOG_EXTENSION)
+        {
+            continue;
+        }
+
+        std::filesystem::path compressedSegment = segment;
+        compressedSegment.replace_extension(COMPRESSED_LOG_EXTENSION);
+        if (compress_log_segment(segment, compressedSegment))
+        {
+            std::error_code errorCode;
+            std::filesystem::remove(segment, errorCode);
+        }
+    }
+}
+
+
+void RotatingBinaryLog::pruneSegments() const
+{
+    const long long minSeconds = std::chrono::duration_cast<std::chrono::seconds>(
+        (std::chrono::system_clock::now() - mOptions.maxSegmentAge).time_since_epoch()).count();
+    unsigned long long totalSize = 0;
+    // From the newest, so that the oldest ones are over the limit.
+    for (const auto& [seconds, segment] : find_log_segments_with_time(mFile) | std::views::reverse)
+    {
+        std::error_code errorCode;
+        const unsigned long long size = std::filesystem::file_size(segment, errorCode);
+        totalSize += errorCode ? 0 : size;
+        if (totalSize > mOptions.maxTotalSize || seconds < minSeconds)
+        {
+            std::filesystem::remove(segment, errorCode);
+        }
+    }
+}
+
+
+bool compress_log_segment(const std::filesystem::path& segment, const std::filesystem::path& compressedSegment)
+{
+    std::ifstream ifs{ segment, std::ios::binary };
+    if (!ifs)
+    {
+        return false;
+    }
+    const std::vector<char> raw{ std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>() };
+    const auto data = std::as_bytes(std::span{ raw });
+
+    // Frames end only where a session starts, so that each of them can be read on its own.
+    std::vector<size_t> frameEnds = find_binary_log_sessions(data);
+    frameEnds.push_back(data.size());
+
+    // Renamed once it's complete, so that a compressed segment is never cut.
+    std::filesystem::path temporaryFile = compressedSegment;
+    temporaryFile += ".tmp";
+    std::ofstream ofs{ temporaryFile, std::ios::binary | std::ios::trunc };
+    const auto lambdaWrite = [&ofs]<typename T>(const T& value)
+        {
+            ofs.write(reinterpret_cast<const char*>(&value), sizeof(T));
+        };
+    ofs.write(COMPRESSED_LOG_MAGIC, sizeof(COMPRESSED_LOG_MAGIC));
+    lambdaWrite(COMPRESSED_LOG_VERSION);
+
+    std::vector<std::byte> compressed;
+    size_t frameStart = 0;
+    bool isSucceeded = true;
+    for (const size_t frameEnd : frameEnds)
+    {
+        if ((frameEnd - frameStart < COMPRESSED_LOG_FRAME_SIZE && frameEnd != data.size()) || frameEnd == frameStart)
+        {
+            continue;
+        }
+
+        const auto frame = data.subspan(frameStart, frameEnd - frameStart);
+        isSucceeded = frame.size() <= std::numeric_limits<unsigned int>::max() && compress_bytes(frame, compressed) &&
+            compressed.size() <= std::numeric_limits<unsigned int>::max();
+        if (!isSucceeded)
+        {
+            break;
+        }
+        ofs.write(reinterpret_cast<const char*>(compressed.data()), static_cast<std::streamsize>(compressed.size()));
+        lambdaWrite(static_cast<unsigned int>(compressed.size()));
+        lambdaWrite(static_cast<unsigned int>(frame.size()));
+        frameStart = frameEnd;
+    }
+    ofs.close();
+
+    std::error_code errorCode;
+    if (isSucceeded && ofs)
+    {
+        std::filesystem::rename(temporaryFile, compressedSegment, errorCode);
+        if (!errorCode)
+        {
+            return true;
+        }
+    }
+    std::filesystem::remove(temporaryFile, errorCode);
+    return false;
+}
+
+
+bool read_compressed_log_backward(const std::filesystem::path& compressedSegment, const std::function<bool(std::span<const std::byte> frame)>& onFrame)
+{
+    std::ifstream ifs{ compressedSegment, std::ios::binary };
+    const auto lambdaRead = [&ifs]<typename T>(T& out)
+        {
+            ifs.read(reinterpret_cast<char*>(&out), sizeof(T));
+        };
+
+    char magic[sizeof(COMPRESSED_LOG_MAGIC)]{};
+    unsigned int version = 0;
+    lambdaRead(magic);
+    lambdaRead(version);
+    if (!ifs || std::memcmp(magic, COMPRESSED_LOG_MAGIC, sizeof(magic)) != 0 || version != COMPRESSED_LOG_VERSION)
+    {
+        return false;
+    }
+
+    constexpr unsigned long long HEADER_SIZE = sizeof(COMPRESSED_LOG_MAGIC) + sizeof(COMPRESSED_LOG_VERSION);
+    constexpr unsigned long long TRAILER_SIZE = 2 * sizeof(unsigned int);
+    ifs.seekg(0, std::ios::end);
+    auto frameEnd = static_cast<unsigned long long>(ifs.tellg());
+    std::vector<std::byte> compressed;
+    std::vector<std::byte> frame;
+    while (frameEnd > HEADER_SIZE)
+    {
+        // Cut in the middle of a trailer.
+        if (frameEnd < HEADER_SIZE + TRAILER_SIZE)
+        {
+            return false;
+        }
+
+        unsigned int compressedSize = 0;
+        unsigned int rawSize = 0;
+        ifs.seekg(static_cast<std::streamoff>(frameEnd - TRAILER_SIZE));
+        lambdaRead(compressedSize);
+        lambdaRead(rawSize);
+        if (!ifs || compressedSize > frameEnd - TRAILER_SIZE - HEADER_SIZE)
+        {
+            return false;
+        }
+
+        const unsigned long long frameStart = frameEnd - TRAILER_SIZE - compressedSize;
+        compressed.resize(compressedSize);
+        ifs.seekg(static_cast<std::streamoff>(frameStart));
+        ifs.read(reinterpret_cast<char*>(compressed.data()), compressedSize);
+        if (!ifs || !decompress_bytes(compressed, rawSize, frame))
+        {
+            return false;
+        }
+        if (!onFrame(frame))
+        {
+            return true;
+        }
+        frameEnd = frameStart;
+    }
+    return true;
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "binary_log.h"
+
+
+// A binary log that is rotated once it's too large or too old, e.g. "typoon.tylog" is renamed to "typoon.1760000000.tylog",
+// with the time it was rotated at in seconds. Then a background thread compresses it into "typoon.1760000000.tylz",
+// and deletes the oldest segments until they're within the limits.
+
+struct LogRotationOptions
+{
+    // Of the file being written.
+    unsigned long long maxFileSize = 4 * 1024 * 1024;
+    std::chrono::seconds maxFileAge = std::chrono::days{ 1 };
+    // Of all the rotated segments, not counting the file being written.
+    unsigned long long maxTotalSize = 64 * 1024 * 1024;
+    std::chrono::seconds maxSegmentAge = std::chrono::days{ 30 };
+};
+
+
+class RotatingBinaryLog
+{
+public:
+    // Appends to the file if it's still within the limits, and leaves the segments from before to the background thread.
+    RotatingBinaryLog(std::filesystem::path file, const LogRotationOptions& options);
+    // Segments left uncompressed are compressed the next time.
+    ~RotatingBinaryLog() = default;
+
+    RotatingBinaryLog(const RotatingBinaryLog& other) = delete;
+    RotatingBinaryLog(RotatingBinaryLog&& other) noexcept = delete;
+    RotatingBinaryLog& operator=(const RotatingBinaryLog& other) = delete;
+    RotatingBinaryLog& operator=(RotatingBinaryLog&& other) noexcept = delete;
+
+    // Not thread-safe, only the writer thread of the logger writes.
+    void Write(const LogRecord& record);
+    void Flush();
+
+    // Waits for the background thread to finish with everything rotated so far. For the tests.
+    void WaitForBackgroundWork();
+
+private:
+    void rotate();
+    void requestBackgroundWork();
+    // Runs on the background thread.
+    void compressSegments(const std::stop_token& stopToken) const;
+    void pruneSegments() const;
+
+    std::filesystem::path mFile;
+    LogRotationOptions mOptions;
+    std::unique_ptr<BinaryLogWriter> mWriter;
+    std::chrono::system_clock::time_point mRotationTime;
+    unsigned long long mRotationSize = 0;
+
+    std::mutex mMutex;
+    std::condition_variable_any mCondition;
+    unsigned int mRequestedWorkCount = 0;
+    unsigned int mFinishedWorkCount = 0;
+    // Declared after the members it uses, since it starts running in the constructor.
+    std::jthread mBackgroundThread;
+};
+
+
+// The segments rotated out of `file`, the oldest first.
+std::vector<std::filesystem::path> find_log_segments(const std::filesystem::path& file);
+
+// A compressed segment is the magic, then frames of whole sessions of the binary log, each compressed on its own.
+// A frame ends with the size of it compressed and decompressed, so that the last ones can be read without the others.
+bool compress_log_segment(const std::filesystem::path& segment, const std::filesystem::path& compressedSegment);
+
+// Calls `onFrame` with each frame decompressed, from the last one to the first, until it returns false.
+// Each of them can be read with `read_binary_log`. Returns false if the file isn't a compressed segment or is corrupted,
+// even if `onFrame` was called with the frames after the corrupted part.
+bool read_compressed_log_backward(const std::filesystem::path& compressedSegment, const std::function<bool(std::span<const std::byte> frame)>& onFrame);
@@ -1,38 +1,32 @@
 #include "logger.h"
 
 #include <chrono>
-#include <ostream>
+#include <format>
 #include <fstream>
+#include <ostream>
+#include <ranges>
+
+#include "log_rotation.h"
 
 
 Logger::Logger(LogLevel minLogLevel)
     : mMinLogLevel(minLogLevel)
     , mWriterThread([this](const std::stop_token& stopToken)
     {
+        std::wstring line;
         while (true)
         {
-            std::unique_lock queueLock{ mLogQueueMutex };
-            mLogQueueConditionVariable.wait(queueLock, [this] { return mShouldTerminate || !mLogQueue.empty(); });
-
-            if (stopToken.stop_requested()) [[unlikely]]
+            // Checked before writing, so that whatever was logged before the stop request is written.
+            const bool shouldStop = stopToken.stop_requested();
+            const size_t writtenCount = writePendingLogs(line);
+            mPendingCount.fetch_sub(static_cast<unsigned int>(writtenCount));
+            if (shouldStop)
             {
-                queueLock.unlock();
                 break;
             }
-
-            std::wstring line;
-            line = std::move(mLogQueue.front());
-            mLogQueue.pop();
-
-            queueLock.unlock();
-
-            for (std::wostream* stream : mStreams)
-            {
-                *stream << line << std::endl;
-            }
+            mPendingCount.wait(0);
         }
     })
-    , mShouldTerminate(false)
 {
 }
 
@@ -40,18 +34,17 @@ Logger::Logger(LogLevel minLogLevel)
 Logger::~Logger()
 {
     mWriterThread.request_stop();
-    mShouldTerminate = true;
-    mLogQueueConditionVariable.notify_one();
+    mPendingCount.fetch_add(1);
+    mPendingCount.notify_one();
+    mWriterThread.join();
 
-    std::scoped_lock queueLock{ mLogQueueMutex };
-    while (!mLogQueue.empty())
-    {
-        for (std::wostream* stream : mStreams)
-        {
-            *stream << mLogQueue.front() << std::endl;
-        }
-        mLogQueue.pop();
-    }
+    // Logged while the writer thread was stopping.
+    std::wstring line;
+    writePendingLogs(line);
+
+    // The compression threads of the binary outputs log the failures, so they're stopped while the queue is still there.
+    mBinaryOutputs.clear();
+    writePendingLogs(line);
 
     for (const auto pair : std::views::zip(mStreams, mIsStreamOwned))
     {
@@ -85,29 +78,124 @@ void Logger::AddOutput(const std::filesystem::path& filePath)
 }
 
 
-void Logger::Log(const std::wstring& string, LogLevel logLevel)
+void Logger::AddBinaryOutput(const std::filesystem::path& filePath)
 {
-    using namespace std::chrono;
+    AddBinaryOutput(filePath, {});
+}
+
+
+void Logger::AddBinaryOutput(const std::filesystem::path& filePath, const LogRotationOptions& rotationOptions)
+{
+    mBinaryOutputs.emplace_back(std::make_unique<RotatingBinaryLog>(filePath, rotationOptions));
+}
+
 
-    if (logLevel < mMinLogLevel)
+void Logger::Flush(std::chrono::milliseconds timeout)
+{
+    const size_t pushCount = mLogQueue.GetPushCount();
+    std::unique_lock lock{ mFlushMutex };
+    mFlushCondition.wait_for(lock, timeout, [this, pushCount] { return mWrittenCount.load() >= pushCount; });
+}
+
+
+void Logger::push(LogRecord& record)
+{
+    while (!mLogQueue.TryPush(record))
     {
-        return;
+        if (record.logLevel < ELogLevel::ERROR)
+        {
+            record.arguments.Release();
+            mDroppedCount.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        std::this_thread::yield();
     }
 
-    if (logLevel <= ELogLevel::MIN || logLevel >= ELogLevel::MAX) [[unlikely]]
+    // Only a sleeping writer thread needs to be woken up, which is when nothing was pending.
+    if (mPendingCount.fetch_add(1) == 0)
     {
-        return;
+        mPendingCount.notify_one();
     }
+}
+
+
+void append_log_line_prefix(std::wstring& line, std::chrono::system_clock::time_point time, LogLevel logLevel)
+{
+    using namespace std::chrono;
 
     static const std::wstring logLevelStrings[] = { L"", L"[DEBUG] ", L"[INFO] ", L"[WARNING] ", L"[ERROR] ", L"[FATAL] " };
     static const auto tz = current_zone();
 
-    const auto now = zoned_time{ tz, system_clock::now() };
-    std::wstring line = std::format(L"{0:%Y-%m-%d %H:%M:%S} ", now) + logLevelStrings[static_cast<int>(logLevel.logLevel)] + string;
+    std::format_to(std::back_inserter(line), L"{0:%Y-%m-%d %H:%M:%S} ", zoned_time{ tz, time });
+    line.append(logLevelStrings[static_cast<int>(logLevel.logLevel)]);
+}
+
+
+size_t Logger::writePendingLogs(std::wstring& line)
+{
+    size_t writtenCount = 0;
+    const auto lambdaWriteLine = [this, &line]
+        {
+            line.push_back(L'\n');
+            for (std::wostream* stream : mStreams)
+            {
+                stream->write(line.data(), static_cast<std::streamsize>(line.size()));
+            }
+        };
 
+    while (mLogQueue.TryPop([&](LogRecord& record)
+        {
+            for (const std::unique_ptr<RotatingBinaryLog>& binaryOutput : mBinaryOutputs)
+            {
+                binaryOutput->Write(record);
+            }
+            // Nothing is formatted unless there's a text output.
+            if (!mStreams.empty())
+            {
+                line.clear();
+                append_log_line_prefix(line, record.time, record.logLevel);
+                record.arguments.AppendTo(line);
+                lambdaWriteLine();
+            }
+            record.arguments.Release();
+        }))
+    {
+        writtenCount++;
+    }
+
+    if (const size_t droppedCount = mDroppedCount.exchange(0); droppedCount > 0)
+    {
+        LogRecord record{ std::chrono::system_clock::now(), ELogLevel::WARNING, __LINE__, __FILE__ };
+        record.arguments.Append(droppedCount);
+        record.arguments.Append("logs were dropped since the queue was full.");
+        for (const std::unique_ptr<RotatingBinaryLog>& binaryOutput : mBinaryOutputs)
+        {
+            binaryOutput->Write(record);
+        }
+        line.clear();
+        append_log_line_prefix(line, record.time, record.logLevel);
+        record.arguments.AppendTo(line);
+        lambdaWriteLine();
+    }
+    else if (writtenCount == 0)
+    {
+        return 0;
+    }
+
+    // Once per batch instead of once per line.
+    for (std::wostream* stream : mStreams)
+    {
+        stream->flush();
+    }
+    for (const std::unique_ptr<RotatingBinaryLog>& binaryOutput : mBinaryOutputs)
+    {
+        binaryOutput->Flush();
+    }
     {
-        std::scoped_lock lock{ mLogQueueMutex };
-        mLogQueue.push(std::move(line));
+        // Under the lock, so that `Flush` can't miss it between checking the count and waiting.
+        std::lock_guard lock{ mFlushMutex };
+        mWrittenCount.fetch_add(writtenCount);
     }
-    mLogQueueConditionVariable.notify_one();
+    mFlushCondition.notify_all();
+    return writtenCount;
 }
@@ -1,75 +1,25 @@
 #pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <filesystem>
 #include <iostream>
+#include <memory>
 #include <mutex>
+#include <ranges>
+#include <source_location>
 #include <string>
 #include <thread>
-#include <queue>
-#include <ranges>
+#include <vector>
+
+#include "log_arguments.h"
+#include "mpsc_ring_buffer.h"
 #undef ERROR
 #undef DEBUG
 
 
-namespace _impl
-{
-template<typename T>
-concept CanConstructWStringWith = requires(T t)
-{
-    std::wstring{ t };
-};
-
-template<typename T>
-concept CanConvertibleToWString = requires(T t)
-{
-    std::to_wstring(t);
-};
-
-template<typename T>
-concept CanConstructStringWith = requires(T t)
-{
-    std::string{ t };
-};
-
-template<typename T>
-concept CanConvertibleToString = requires(T t)
-{
-    std::to_string(t);
-};
-
-template<typename T>
-concept CanBeString = CanConstructWStringWith<T> || CanConvertibleToWString<T> || CanConstructStringWith<T> || CanConvertibleToString<T> || std::is_same_v<std::remove_cvref_t<T>, bool>;
-
-template<CanBeString T>
-std::wstring to_wstring(const T& t)
-{
-    if constexpr (std::is_same_v<std::remove_cvref_t<T>, bool>)
-    {
-        return t ? L"true" : L"false";
-    }
-    else if constexpr (CanConstructWStringWith<T>)
-    {
-        return std::wstring{ t };
-    }
-    else if constexpr (CanConvertibleToWString<T>)
-    {
-        return std::to_wstring(t);
-    }
-    else if constexpr (CanConstructStringWith<T>)
-    {
-        std::string s{ t };
-        return std::wstring{ s.begin(), s.end() };
-    }
-    else if constexpr (CanConvertibleToString<T>)
-    {
-        std::string s = std::to_string(t);
-        return std::wstring{ s.begin(), s.end() };
-    }
-    else
-    {
-        std::unreachable();
-    }
-}
-}
+struct LogRotationOptions;
+class RotatingBinaryLog;
 
 
 struct LogLevel
@@ -92,25 +42,80 @@ struct LogLevel
     ELogLevel logLevel;
 };
 
+// The type of each level, so that the level of a log is known at compile time.
+template<LogLevel::ELogLevel Level>
+struct StaticLogLevel : LogLevel
+{
+    constexpr StaticLogLevel() : LogLevel{ Level } {}
+};
+
 namespace ELogLevel
 {
 
-constexpr struct LogLevelMin : LogLevel {} MIN{ LogLevel::ELogLevel::MIN };
+constexpr StaticLogLevel<LogLevel::ELogLevel::MIN> MIN;
 
-constexpr struct LogLevelDebug : LogLevel {} DEBUG{ LogLevel::ELogLevel::DEBUG };
-constexpr struct LogLevelInfo : LogLevel {} INFO{ LogLevel::ELogLevel::INFO };
-constexpr struct LogLevelWarning : LogLevel {} WARNING{ LogLevel::ELogLevel::WARNING };
-constexpr struct LogLevelError : LogLevel {} ERROR{ LogLevel::ELogLevel::ERROR };
-constexpr struct LogLevelFatal : LogLevel {} FATAL{ LogLevel::ELogLevel::FATAL };
+constexpr StaticLogLevel<LogLevel::ELogLevel::DEBUG> DEBUG;
+constexpr StaticLogLevel<LogLevel::ELogLevel::INFO> INFO;
+constexpr StaticLogLevel<LogLevel::ELogLevel::WARNING> WARNING;
+constexpr StaticLogLevel<LogLevel::ELogLevel::ERROR> ERROR;
+constexpr StaticLogLevel<LogLevel::ELogLevel::FATAL> FATAL;
 
-constexpr struct LogLevelMax : LogLevel {} MAX{ LogLevel::ELogLevel::MAX };
+constexpr StaticLogLevel<LogLevel::ELogLevel::MAX> MAX;
 
 }
 
 
+// Logs below it are compiled out, arguments and all. Define `MIN_LOG_LEVEL` to override it, e.g. `MIN_LOG_LEVEL=WARNING`.
+#ifndef MIN_LOG_LEVEL
+#ifdef _DEBUG
+#define MIN_LOG_LEVEL DEBUG
+#else
+#define MIN_LOG_LEVEL INFO
+#endif
+#endif
+constexpr LogLevel MIN_COMPILED_LOG_LEVEL{ LogLevel::ELogLevel::MIN_LOG_LEVEL };
+
+template<LogLevel::ELogLevel Level>
+concept IsLogLevelCompiledOut = LogLevel{ Level } < MIN_COMPILED_LOG_LEVEL;
+
+
+// Where a log is from, which is the event of the log in the binary log.
+// Converted from the level implicitly, so that the callers don't have to pass the location.
+struct LogSite
+{
+    LogSite(LogLevel logLevel, const std::source_location& location = std::source_location::current())
+        : logLevel(logLevel)
+        , file(location.file_name())
+        , line(location.line())
+    {}
+
+    LogLevel logLevel;
+    const char* file;
+    unsigned int line;
+};
+
+
+// What the callers hand over to the writer thread, which does all the formatting.
+struct LogRecord
+{
+    std::chrono::system_clock::time_point time;
+    LogLevel logLevel;
+    unsigned int line;
+    const char* file;
+    LogArguments arguments;
+};
+
+// "2024-01-31 12:34:56.1234567 [INFO] ", before the arguments.
+void append_log_line_prefix(std::wstring& line, std::chrono::system_clock::time_point time, LogLevel logLevel);
+
+
+// Logging only copies the arguments into a lock-free queue, and a background thread formats and writes them.
+// When the queue is full, logs below `ELogLevel::ERROR` are dropped and counted, instead of making the caller wait.
 class Logger
 {
 public:
+    static constexpr size_t QUEUE_CAPACITY = 1024;
+
     Logger(LogLevel minLogLevel = ELogLevel::ERROR);
     ~Logger();
 
@@ -121,65 +126,106 @@ public:
 
     void AddOutput(std::wostream& stream);
     void AddOutput(const std::filesystem::path& filePath);
+    // Writes the logs unformatted, which is much cheaper. Read them with LogDecoder.
+    // Rotated with the default options, see `RotatingBinaryLog`.
+    void AddBinaryOutput(const std::filesystem::path& filePath);
+    void AddBinaryOutput(const std::filesystem::path& filePath, const LogRotationOptions& rotationOptions);
 
-    void Log(const std::wstring& string, LogLevel logLevel = ELogLevel::INFO);
+    // At `ELogLevel::INFO`.
+    template<_impl::CanBeString T>
+    void Log(const T& t, const std::source_location& location = std::source_location::current());
 
     template<_impl::CanBeString T>
-    void Log(const T& t, LogLevel logLevel = ELogLevel::INFO);
+    void Log(const T& t, LogSite site);
 
     template<_impl::CanBeString T, _impl::CanBeString ...Ts>
-    void Log(LogLevel logLevel, const T& t, const Ts& ...ts);
+    void Log(LogSite site, const T& t, const Ts& ...ts);
 
-#ifndef _DEBUG
-    void Log(const std::wstring&, ELogLevel::LogLevelDebug) {}
+    // Chosen over the above for the levels compiled out, since the levels match exactly.
+    template<LogLevel::ELogLevel Level, _impl::CanBeString T>
+        requires IsLogLevelCompiledOut<Level>
+    void Log(const T&, StaticLogLevel<Level>) {}
 
-    template<_impl::CanBeString T>
-    void Log(const T&, ELogLevel::LogLevelDebug) {}
+    template<LogLevel::ELogLevel Level, _impl::CanBeString T, _impl::CanBeString ...Ts>
+        requires IsLogLevelCompiledOut<Level>
+    void Log(StaticLogLevel<Level>, const T&, const Ts& ...) {}
 
-    template<_impl::CanBeString T, _impl::CanBeString ...Ts>
-    void Log(ELogLevel::LogLevelDebug, const T&, const Ts& ...) {}
-#endif
+    // Waits for the writer thread to write everything logged so far, but not longer than `timeout`.
+    // For when the process is about to die, e.g. from a crash.
+    void Flush(std::chrono::milliseconds timeout = std::chrono::seconds{ 1 });
 
 
 private:
+    template<typename ...Ts>
+    void log(const LogSite& site, const Ts& ...ts);
+
+    void push(LogRecord& record);
+
+    // Writes every log in the queue, and returns how many were written.
+    size_t writePendingLogs(std::wstring& line);
+
     LogLevel mMinLogLevel;
 
     std::vector<std::wostream*> mStreams;
     std::vector<bool> mIsStreamOwned;
-
+    std::vector<std::unique_ptr<RotatingBinaryLog>> mBinaryOutputs;
+
+    MpscRingBuffer<LogRecord, QUEUE_CAPACITY> mLogQueue;
+    // Pushed but not written yet. The writer thread sleeps on it while it's 0.
+    std::atomic<unsigned int> mPendingCount = 0;
+    std::atomic<size_t> mWrittenCount = 0;
+    std::atomic<size_t> mDroppedCount = 0;
+    // Notified after each batch is written, for `Flush`.
+    std::mutex mFlushMutex;
+    std::condition_variable mFlushCondition;
+
+    // Last, so that the thread starts after everything else is ready.
     std::jthread mWriterThread;
-
-    std::queue<std::wstring> mLogQueue;
-    std::mutex mLogQueueMutex;
-    std::condition_variable mLogQueueConditionVariable;
-    std::atomic<bool> mShouldTerminate;
 };
 
 
 template<_impl::CanBeString T>
-void Logger::Log(const T& t, LogLevel logLevel)
+void Logger::Log(const T& t, const std::source_location& location)
+{
+    if constexpr (!IsLogLevelCompiledOut<LogLevel::ELogLevel::INFO>)
+    {
+        Log(t, LogSite{ ELogLevel::INFO, location });
+    }
+}
+
+template<_impl::CanBeString T>
+void Logger::Log(const T& t, LogSite site)
 {
-    if (logLevel < mMinLogLevel)
+    if (site.logLevel < mMinLogLevel)
     {
         return;
     }
 
-    Log(_impl::to_wstring(t), logLevel);
+    log(site, t);
 }
 
 template<_impl::CanBeString T, _impl::CanBeString ...Ts>
-void Logger::Log(LogLevel logLevel, const T& t, const Ts& ...ts)
+void Logger::Log(LogSite site, const T& t, const Ts& ...ts)
 {
-    if (logLevel < mMinLogLevel)
+    if (site.logLevel < mMinLogLevel)
     {
         return;
     }
 
-    Log((_impl::to_wstring(t) + ... + (L" " + _impl::to_wstring(ts))), logLevel);
+    log(site, t, ts...);
 }
 
-#ifdef _DEBUG
-inline Logger logger{ ELogLevel::DEBUG };
-#else
-inline Logger logger{ ELogLevel::INFO };
-#endif
+template<typename ...Ts>
+void Logger::log(const LogSite& site, const Ts& ...ts)
+{
+    if (site.logLevel <= ELogLevel::MIN || site.logLevel >= ELogLevel::MAX) [[unlikely]]
+    {
+        return;
+    }
+
+    LogRecord record{ std::chrono::system_clock::now(), site.logLevel, site.line, site.file };
+    (record.arguments.Append(ts), ...);
+    push(record);
+}
+
+inline Logger logger{ MIN_COMPILED_LOG_LEVEL };
@@ -0,0 +1,104 @@
+#pragma once
+#include <atomic>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <memory>
+
+
+// A bounded queue which any thread can push into, and only a single thread pops from.
+// Neither side takes a lock or allocates. Pushing into a full buffer fails instead of waiting.
+// Each slot has a sequence number telling whether it's free to write or ready to read for the current lap.
+template<typename T, size_t Capacity>
+class MpscRingBuffer
+{
+    static_assert(std::has_single_bit(Capacity), "The positions are wrapped with a mask.");
+
+public:
+    MpscRingBuffer()
+        : mSlots(std::make_unique<Slot[]>(Capacity))
+    {
+        for (size_t i = 0; i < Capacity; i++)
+        {
+            mSlots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscRingBuffer(const MpscRingBuffer& other) = delete;
+    MpscRingBuffer(MpscRingBuffer&& other) noexcept = delete;
+    MpscRingBuffer& operator=(const MpscRingBuffer& other) = delete;
+    MpscRingBuffer& operator=(MpscRingBuffer&& other) noexcept = delete;
+
+    // `write` is called with the claimed slot, so that the value is built in place.
+    template<std::invocable<T&> F>
+    bool TryPush(F&& write)
+    {
+        size_t position = mPushPosition.load(std::memory_order_relaxed);
+        while (true)
+        {
+            Slot& slot = mSlots[position & (Capacity - 1)];
+            const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            const auto lap = static_cast<std::ptrdiff_t>(sequence - position);
+            if (lap == 0)
+            {
+                if (mPushPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    write(slot.value);
+                    slot.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (lap < 0)
+            {
+                // The consumer hasn't read the slot from the previous lap yet.
+                return false;
+            }
+            else
+            {
+                position = mPushPosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool TryPush(const T& value)
+    {
+        return TryPush([&value](T& slot) { slot = value; });
+    }
+
+    // Only from the consumer thread. `read` is called with the slot, which is reused once it returns.
+    template<std::invocable<T&> F>
+    bool TryPop(F&& read)
+    {
+        Slot& slot = mSlots[mPopPosition & (Capacity - 1)];
+        const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != mPopPosition + 1)
+        {
+            return false;
+        }
+
+        read(slot.value);
+        slot.sequence.store(mPopPosition + Capacity, std::memory_order_release);
+        mPopPosition++;
+        return true;
+    }
+
+    bool TryPop(T& value)
+    {
+        return TryPop([&value](T& slot) { value = slot; });
+    }
+
+    // The number of pushes claimed so far, including the ones still being written.
+    [[nodiscard]] size_t GetPushCount() const { return mPushPosition.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot
+    {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Slot[]> mSlots;
+    // Apart from each other, so that the producers don't invalidate the cache line of the consumer.
+    alignas(64) std::atomic<size_t> mPushPosition = 0;
+    alignas(64) size_t mPopPosition = 0;
+};
@@ -1,19 +1,69 @@
 ﻿#include "./string.h"
 
-#include <cwctype>
+#include <algorithm>
+#include <bit>
+#include <cwchar>
 
+#include <uni-algo/case.h>
 #include <uni-algo/conv.h>
+#include <uni-algo/prop.h>
 #include <json5/json5_base.hpp>
 
 #include "../imm/composition.h"
 #include "logger.h"
 
+#if WCHAR_MAX == 0xFFFF && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define CAN_SCAN_ASCII_WITH_SSE2
+#include <immintrin.h>
+#endif
 
-bool is_cased_alpha(wchar_t c)
+
+constexpr std::array<CharProperties, 0x10000> make_char_properties()
 {
-    return std::iswalpha(c) && (std::iswupper(c) ^ std::iswlower(c));
+    std::array<CharProperties, 0x10000> properties{};
+    for (char32_t c = 0; c < properties.size(); c++)
+    {
+        CharProperties& property = properties[c];
+        property.folded = static_cast<wchar_t>(c);
+        property.upper = static_cast<wchar_t>(c);
+        // Not a character by itself.
+        if (una::codepoint::is_surrogate(c))
+        {
+            continue;
+        }
+
+        const una::codepoint::prop prop{ c };
+        if (prop.Alphabetic() || prop.Numeric())
+        {
+            property.flags |= CharProperties::ALNUM;
+        }
+
+        // Either of the cases, not both or neither of them(e.g. titlecase letters).
+        if (const una::codepoint::prop_case propCase{ c };
+            prop.Alphabetic() && propCase.Uppercase() != propCase.Lowercase())
+        {
+            property.flags |= CharProperties::CASED_ALPHA;
+            if (propCase.Uppercase())
+            {
+                property.flags |= CharProperties::UPPERCASE;
+            }
+            if (const char32_t lower = una::codepoint::to_simple_lowercase(c);
+                lower < properties.size())
+            {
+                property.folded = static_cast<wchar_t>(lower);
+            }
+            if (const char32_t upper = una::codepoint::to_simple_uppercase(c);
+                upper < properties.size())
+            {
+                property.upper = static_cast<wchar_t>(upper);
+            }
+        }
+    }
+    return properties;
 }
 
+extern constinit const std::array<CharProperties, 0x10000> char_properties = make_char_properties();
+
 std::wstring to_u16_string(const std::string& str)
 {
     if (una::is_valid_utf8(str))
@@ -34,63 +84,181 @@ std::string to_u8_string(const std::wstring& str)
 #pragma warning(default:4244)
 }
 
+/// The compatibility jamo a part of a Hangeul letter is normalized into, at most 2 of them.
+struct NormalizedJamo
+{
+    wchar_t letters[2]{};
+    unsigned char length = 0;
+};
+
+template<size_t N>
+constexpr std::array<NormalizedJamo, N> make_normalized_jamo_table(const std::wstring_view(&normalized)[N])
+{
+    std::array<NormalizedJamo, N> table{};
+    for (size_t i = 0; i < N; i++)
+    {
+        std::ranges::copy(normalized[i], table[i].letters);
+        table[i].length = static_cast<unsigned char>(normalized[i].size());
+    }
+    return table;
+}
+
+constexpr std::wstring_view CHOSEONGS[] = {
+    L"ㄱ", L"ㄲ", L"ㄴ", L"ㄷ", L"ㄸ", L"ㄹ", L"ㅁ", L"ㅂ", L"ㅃ", L"ㅅ", L"ㅆ", L"ㅇ", L"ㅈ", L"ㅉ", L"ㅊ", L"ㅋ", L"ㅌ", L"ㅍ", L"ㅎ"
+};
+constexpr std::wstring_view JUNGSEONGS[] = {
+    L"ㅏ", L"ㅐ", L"ㅑ", L"ㅒ", L"ㅓ", L"ㅔ", L"ㅕ", L"ㅖ", L"ㅗ", L"ㅗㅏ", L"ㅗㅐ", L"ㅗㅣ", L"ㅛ", L"ㅜ", L"ㅜㅓ", L"ㅜㅔ", L"ㅜㅣ", L"ㅠ", L"ㅡ", L"ㅡㅣ", L"ㅣ"
+};
+constexpr std::wstring_view JONGSEONGS[] = {
+    L"", L"ㄱ", L"ㄲ", L"ㄱㅅ", L"ㄴ", L"ㄴㅈ", L"ㄴㅎ", L"ㄷ", L"ㄹ", L"ㄹㄱ", L"ㄹㅁ", L"ㄹㅂ", L"ㄹㅅ", L"ㄹㅌ", L"ㄹㅍ", L"ㄹㅎ", L"ㅁ", L"ㅂ", L"ㅂㅅ", L"ㅅ", L"ㅆ", L"ㅇ", L"ㅈ", L"ㅊ", L"ㅋ", L"ㅌ", L"ㅍ", L"ㅎ"
+};
+constexpr std::wstring_view CONSONANTS[] = {
+    L"ㄱ", L"ㄲ", L"ㄱㅅ", L"ㄴ", L"ㄴㅈ", L"ㄴㅎ", L"ㄷ", L"ㄸ", L"ㄹ", L"ㄹㄱ", L"ㄹㅁ", L"ㄹㅂ", L"ㄹㅅ", L"ㄹㅌ", L"ㄹㅍ", L"ㄹㅎ", L"ㅁ", L"ㅂ", L"ㅃ", L"ㅂㅅ", L"ㅅ", L"ㅆ", L"ㅇ", L"ㅈ", L"ㅉ", L"ㅊ", L"ㅋ", L"ㅌ", L"ㅍ", L"ㅎ"
+};
+constexpr auto CHOSEONG_TABLE = make_normalized_jamo_table(CHOSEONGS);
+constexpr auto JUNGSEONG_TABLE = make_normalized_jamo_table(JUNGSEONGS);
+constexpr auto JONGSEONG_TABLE = make_normalized_jamo_table(JONGSEONGS);
+constexpr auto CONSONANT_TABLE = make_normalized_jamo_table(CONSONANTS);
+
+static_assert(1 + 2 + 2 == MAX_NORMALIZED_HANGEUL_LENGTH);
+
+
+// The length of the leading ASCII letters of `str`, checking 8 of them at once where it can.
+size_t count_leading_ascii(std::wstring_view str)
+{
+    size_t index = 0;
+#ifdef CAN_SCAN_ASCII_WITH_SSE2
+    const __m128i nonAsciiBits = _mm_set1_epi16(static_cast<short>(0xFF80));
+    for (; index + 8 <= str.size(); index += 8)
+    {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str.data() + index));
+        if (const auto mask = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(chunk, nonAsciiBits), _mm_setzero_si128())));
+            mask != 0xFFFF)
+        {
+            // 2 bits for each letter.
+            return index + std::countr_one(mask) / 2;
+        }
+    }
+#endif
+    while (index < str.size() && str[index] < 0x80)
+    {
+        index++;
+    }
+    return index;
+}
+
+
+// Writes the letters as far as `result` can hold, while counting all of them.
+class SpanWriter
+{
+public:
+    explicit SpanWriter(std::span<wchar_t> result) : mResult(result) {}
+
+    void Write(wchar_t letter)
+    {
+        if (mLength < mResult.size())
+        {
+            mResult[mLength] = letter;
+        }
+        mLength++;
+    }
+    void Write(const NormalizedJamo& jamo)
+    {
+        if (mLength + std::size(jamo.letters) <= mResult.size()) [[likely]]
+        {
+            // Copy both of the letters without looking at the length, the extra one is left past the written length.
+            mResult[mLength] = jamo.letters[0];
+            mResult[mLength + 1] = jamo.letters[1];
+            mLength += jamo.length;
+            return;
+        }
+        for (unsigned char i = 0; i < jamo.length; i++)
+        {
+            Write(jamo.letters[i]);
+        }
+    }
+    // The letters which are the same after the conversion, copied all at once.
+    void WriteAsIs(std::wstring_view letters)
+    {
+        if (mLength < mResult.size())
+        {
+            std::ranges::copy(letters.substr(0, mResult.size() - mLength), mResult.begin() + static_cast<std::ptrdiff_t>(mLength));
+        }
+        mLength += letters.size();
+    }
+
+    [[nodiscard]] size_t GetLength() const { return mLength; }
+
+private:
+    std::span<wchar_t> mResult;
+    size_t mLength = 0;
+};
+
+
 std::wstring normalize_hangeul(std::wstring_view str)
 {
     std::wstring result;
-    result.reserve(str.size());
+    normalize_hangeul(str, result);
+    return result;
+}
 
-    for (const wchar_t c : str)
+void normalize_hangeul(std::wstring_view str, std::wstring& result)
+{
+    result.resize_and_overwrite(str.size() * MAX_NORMALIZED_HANGEUL_LENGTH,
+        [str](wchar_t* buffer, size_t size) { return normalize_hangeul(str, std::span{ buffer, size }); });
+}
+
+size_t normalize_hangeul(std::wstring_view str, std::span<wchar_t> result)
+{
+    SpanWriter writer{ result };
+    for (size_t i = 0; i < str.size();)
     {
-        static constexpr wchar_t choseongMap[] = {
-            L'ㄱ', L'ㄲ', L'ㄴ', L'ㄷ', L'ㄸ', L'ㄹ', L'ㅁ', L'ㅂ', L'ㅃ', L'ㅅ', L'ㅆ', L'ㅇ', L'ㅈ', L'ㅉ', L'ㅊ', L'ㅋ', L'ㅌ', L'ㅍ', L'ㅎ'
-        };
-        static constexpr std::wstring_view jungseongMap[] = {
-            L"ㅏ", L"ㅐ", L"ㅑ", L"ㅒ", L"ㅓ", L"ㅔ", L"ㅕ", L"ㅖ", L"ㅗ", L"ㅗㅏ", L"ㅗㅐ", L"ㅗㅣ", L"ㅛ", L"ㅜ", L"ㅜㅓ", L"ㅜㅔ", L"ㅜㅣ", L"ㅠ", L"ㅡ", L"ㅡㅣ", L"ㅣ"
-        };
-        static constexpr std::wstring_view jongseongMap[] = {
-            L"", L"ㄱ", L"ㄲ", L"ㄱㅅ", L"ㄴ", L"ㄴㅈ", L"ㄴㅎ", L"ㄷ", L"ㄹ", L"ㄹㄱ", L"ㄹㅁ", L"ㄹㅂ", L"ㄹㅅ", L"ㄹㅌ", L"ㄹㅍ", L"ㄹㅎ", L"ㅁ", L"ㅂ", L"ㅂㅅ", L"ㅅ", L"ㅆ", L"ㅇ", L"ㅈ", L"ㅊ", L"ㅋ", L"ㅌ", L"ㅍ", L"ㅎ"
-        };
-        static constexpr std::wstring_view consonantMap[] = {
-            L"ㄱ", L"ㄲ", L"ㄱㅅ", L"ㄴ", L"ㄴㅈ", L"ㄴㅎ", L"ㄷ", L"ㄸ", L"ㄹ", L"ㄹㄱ", L"ㄹㅁ", L"ㄹㅂ", L"ㄹㅅ", L"ㄹㅌ", L"ㄹㅍ", L"ㄹㅎ", L"ㅁ", L"ㅂ", L"ㅃ", L"ㅂㅅ", L"ㅅ", L"ㅆ", L"ㅇ", L"ㅈ", L"ㅉ", L"ㅊ", L"ㅋ", L"ㅌ", L"ㅍ", L"ㅎ"
-        };
+        if (str[i] < 0x80)
+        {
+            const size_t asciiLength = count_leading_ascii(str.substr(i));
+            writer.WriteAsIs(str.substr(i, asciiLength));
+            i += asciiLength;
+            continue;
+        }
 
+        const wchar_t c = str[i++];
         if (L'가' <= c && c <= L'힣')
         {
-            constexpr int lettersOfAChoseong = static_cast<int>(std::size(jungseongMap) * std::size(jongseongMap));
-            auto [choseong, nonChoseong] = std::div(c - L'가', lettersOfAChoseong);
-            auto [jungseong, jongseong] = std::div(nonChoseong, static_cast<int>(std::size(jongseongMap)));
-            result += choseongMap[choseong];
-            result += jungseongMap[jungseong];
-            result += jongseongMap[jongseong];
+            // Divided by the constants, which are cheaper than `std::div`.
+            constexpr int lettersOfAJungseong = static_cast<int>(std::size(JONGSEONGS));
+            constexpr int lettersOfAChoseong = static_cast<int>(std::size(JUNGSEONGS)) * lettersOfAJungseong;
+            const int index = c - L'가';
+            writer.Write(CHOSEONG_TABLE[index / lettersOfAChoseong]);
+            writer.Write(JUNGSEONG_TABLE[index % lettersOfAChoseong / lettersOfAJungseong]);
+            writer.Write(JONGSEONG_TABLE[index % lettersOfAJungseong]);
         }
         else if (L'ㄱ' <= c && c <= L'ㅎ')
         {
-            result += consonantMap[c - L'ㄱ'];
+            writer.Write(CONSONANT_TABLE[c - L'ㄱ']);
         }
         else if (L'ㅏ' <= c && c <= L'ㅣ')
         {
-            result += jungseongMap[c - L'ㅏ'];
+            writer.Write(JUNGSEONG_TABLE[c - L'ㅏ']);
         }
         // '조합형'(NFC) letters. i.e., these letters also carry the information what part(initial, medial, or final) they are.
         else if (L'ᄀ' <= c && c <= L'ᄒ') [[unlikely]]
         {
-            result += choseongMap[c - L'ᄀ'];
+            writer.Write(CHOSEONG_TABLE[c - L'ᄀ']);
         }
         else if (L'ᅡ' <= c && c <= L'ᅵ') [[unlikely]]
         {
-            result += jungseongMap[c - L'ᅡ'];
+            writer.Write(JUNGSEONG_TABLE[c - L'ᅡ']);
         }
         else if (L'ᆨ' <= c && c <= L'ᇂ') [[unlikely]]
         {
-            result += jongseongMap[c - L'ᆨ' + 1];  // Make up for the 'no final'.
+            writer.Write(JONGSEONG_TABLE[c - L'ᆨ' + 1]);  // Make up for the 'no final'.
         }
         else
         {
-            result += c;
+            writer.Write(c);
         }
     }
-
-    return result;
+    return writer.GetLength();
 }
 
 
@@ -113,75 +281,86 @@ std::wstring combine_hangeul(std::wstring_view str)
 }
 
 
+// Support only two-set keyboard layout for now.
+// a~z
+constexpr wchar_t LOWER_ALPHABET_TO_HANGEUL[] = L"ㅁㅠㅊㅇㄷㄹㅎㅗㅑㅓㅏㅣㅡㅜㅐㅔㅂㄱㄴㅅㅕㅍㅈㅌㅛㅋ";
+constexpr wchar_t UPPER_ALPHABET_TO_HANGEUL[] = L"ㅁㅠㅊㅇㄸㄹㅎㅗㅑㅓㅏㅣㅡㅜㅒㅖㅃㄲㄴㅆㅕㅍㅉㅌㅛㅋ";
+
+// ㄱ~ㅣ, 0 if there's no key for it.
+constexpr char HANGEUL_TO_ALPHABET[] = {
+    'r', 'R', 0, 's', 0, 0, 'e', 'E', 'f', 0, 0, 0, 0, 0, 0, 0, 'a', 'q', 'Q', 0, 't', 'T', 'd', 'w', 'W', 'c', 'z', 'x', 'v', 'g',
+    'k', 'o', 'i', 'O', 'j', 'p', 'u', 'P', 'h', 0, 0, 0, 'y', 'n', 0, 0, 0, 'b', 'm', 0, 'l'
+};
+// Same as above, but with the caps lock on.
+constexpr auto HANGEUL_TO_ALPHABET_CAPS_LOCKED = []
+    {
+        std::array<char, std::size(HANGEUL_TO_ALPHABET)> table{};
+        std::ranges::transform(HANGEUL_TO_ALPHABET, table.begin(),
+            [](char c) { return static_cast<char>('a' <= c && c <= 'z' ? c - 'a' + 'A' : 'A' <= c && c <= 'Z' ? c - 'A' + 'a' : c); });
+        return table;
+    }();
+
+
 std::wstring alphabet_to_hangeul(std::wstring_view str)
 {
     std::wstring result;
-    result.reserve(str.size());
-
-    // Support only two-set keyboard layout for now.
-    // a~z
-    constexpr wchar_t lowerAlphabetToHangul[] = L"ㅁㅠㅊㅇㄷㄹㅎㅗㅑㅓㅏㅣㅡㅜㅐㅔㅂㄱㄴㅅㅕㅍㅈㅌㅛㅋ";
-    constexpr wchar_t upperAlphabetToHangul[] = L"ㅁㅠㅊㅇㄸㄹㅎㅗㅑㅓㅏㅣㅡㅜㅒㅖㅃㄲㄴㅆㅕㅍㅉㅌㅛㅋ";
+    result.resize_and_overwrite(str.size(), [str](wchar_t* buffer, size_t size) { return alphabet_to_hangeul(str, std::span{ buffer, size }); });
+    return result;
+}
 
-    for (const wchar_t& character : str)
+size_t alphabet_to_hangeul(std::wstring_view str, std::span<wchar_t> result)
+{
+    SpanWriter writer{ result };
+    for (const wchar_t character : str)
     {
-        if ('a' <= character && character <= 'z')
+        if (L'a' <= character && character <= L'z')
         {
-            result += lowerAlphabetToHangul[character - L'a'];
+            writer.Write(LOWER_ALPHABET_TO_HANGEUL[character - L'a']);
         }
-        else if ('A' <= character && character <= 'Z')
+        else if (L'A' <= character && character <= L'Z')
         {
-            result += upperAlphabetToHangul[character - L'A'];
+            writer.Write(UPPER_ALPHABET_TO_HANGEUL[character - L'A']);
         }
         else
         {
-            result += character;
+            writer.Write(character);
         }
     }
-
-    return result;
+    return writer.GetLength();
 }
 
 std::wstring hangeul_to_alphabet(std::wstring_view normalizedStr, bool isCapsLockOn)
 {
     std::wstring result;
-    result.reserve(normalizedStr.size());
+    hangeul_to_alphabet(normalizedStr, isCapsLockOn, result);
+    return result;
+}
 
-    // Support only two-set keyboard layout for now.
-    // ㄱ~ㅣ
-    constexpr char hangeulToAlphabet[] = {
-        'r', 'R', 0, 's', 0, 0, 'e', 'E', 'f', 0, 0, 0, 0, 0, 0, 0, 'a', 'q', 'Q', 0, 't', 'T', 'd', 'w', 'W', 'c', 'z', 'x', 'v', 'g',
-        'k', 'o', 'i', 'O', 'j', 'p', 'u', 'P', 'h', 0, 0, 0, 'y', 'n', 0, 0, 0, 'b', 'm', 0, 'l'
-    };
+void hangeul_to_alphabet(std::wstring_view normalizedStr, bool isCapsLockOn, std::wstring& result)
+{
+    result.resize_and_overwrite(normalizedStr.size(),
+        [normalizedStr, isCapsLockOn](wchar_t* buffer, size_t size) { return hangeul_to_alphabet(normalizedStr, isCapsLockOn, std::span{ buffer, size }); });
+}
 
-    for (const wchar_t& character : normalizedStr)
+size_t hangeul_to_alphabet(std::wstring_view normalizedStr, bool isCapsLockOn, std::span<wchar_t> result)
+{
+    const std::span<const char> table = isCapsLockOn ? std::span<const char>{ HANGEUL_TO_ALPHABET_CAPS_LOCKED } : std::span<const char>{ HANGEUL_TO_ALPHABET };
+
+    SpanWriter writer{ result };
+    for (size_t i = 0; i < normalizedStr.size();)
     {
-        if (L'ㄱ' <= character && character <= L'ㅣ')
+        if (normalizedStr[i] < 0x80)
         {
-            const char c = hangeulToAlphabet[character - L'ㄱ'];
-            if (isCapsLockOn)
-            {
-                if (std::isupper(c))
-                {
-                    result += static_cast<wchar_t>(std::tolower(c));
-                }
-                else
-                {
-                    result += static_cast<wchar_t>(std::toupper(c));
-                }
-            }
-            else
-            {
-                result += c;
-            }
+            const size_t asciiLength = count_leading_ascii(normalizedStr.substr(i));
+            writer.WriteAsIs(normalizedStr.substr(i, asciiLength));
+            i += asciiLength;
+            continue;
         }
-        else
-        {
-            result += character;
-        }
-    }
 
-    return result;
+        const wchar_t character = normalizedStr[i++];
+        writer.Write(L'ㄱ' <= character && character <= L'ㅣ' ? static_cast<wchar_t>(table[character - L'ㄱ']) : character);
+    }
+    return writer.GetLength();
 }
 
 
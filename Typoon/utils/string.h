@@ -1,4 +1,6 @@
 ﻿#pragma once
+#include <array>
+#include <span>
 #include <string>
 
 
@@ -8,24 +10,103 @@ struct error;
 }
 
 
+// The properties of a character by the Unicode standard, instead of the locale of the process.
+struct CharProperties
+{
+    enum EFlag : unsigned char
+    {
+        CASED_ALPHA = 1 << 0,
+        ALNUM = 1 << 1,
+        UPPERCASE = 1 << 2,  // Only with `CASED_ALPHA`, lowercase otherwise.
+    };
+
+    wchar_t folded = 0;
+    wchar_t upper = 0;
+    unsigned char flags = 0;
+};
+
+// Of every character in the BMP, generated at compile time.
+extern const std::array<CharProperties, 0x10000> char_properties;
+
+// There's no property outside of the BMP.
+inline CharProperties get_char_properties(wchar_t c)
+{
+    if constexpr (sizeof(wchar_t) > 2)
+    {
+        if (static_cast<size_t>(c) >= char_properties.size())
+        {
+            return { .folded = c, .upper = c };
+        }
+    }
+    return char_properties[static_cast<size_t>(c)];
+}
+
 // Whether the character is alphabetic and has a case.
-bool is_cased_alpha(wchar_t c);
+inline bool is_cased_alpha(wchar_t c)
+{
+    return get_char_properties(c).flags & CharProperties::CASED_ALPHA;
+}
+
+// Whether the character is an uppercase letter, which has a lowercase.
+inline bool is_upper(wchar_t c)
+{
+    return get_char_properties(c).flags & CharProperties::UPPERCASE;
+}
+
+// Whether the character is a lowercase letter, which has an uppercase.
+inline bool is_lower(wchar_t c)
+{
+    return (get_char_properties(c).flags & (CharProperties::CASED_ALPHA | CharProperties::UPPERCASE)) == CharProperties::CASED_ALPHA;
+}
+
+// Uppercase if the character is alphabetic and has a case, the character itself otherwise.
+inline wchar_t to_upper(wchar_t c)
+{
+    return get_char_properties(c).upper;
+}
+
+// Whether the character is alphabetic or numeric.
+inline bool is_alnum(wchar_t c)
+{
+    return get_char_properties(c).flags & CharProperties::ALNUM;
+}
+
+// Lowercase if the character is alphabetic and has a case, the character itself otherwise.
+// Used as the key for case insensitive comparisons.
+inline wchar_t fold_case(wchar_t c)
+{
+    return get_char_properties(c).folded;
+}
 
 std::wstring to_u16_string(const std::string& str);
 
 std::string to_u8_string(const std::wstring& str);
 
+// The most letters a letter can be normalized into, e.g. '곿' -> 'ㄱㅗㅏㄱㅅ'.
+constexpr size_t MAX_NORMALIZED_HANGEUL_LENGTH = 5;
+
 // Separate all the letters in each Korean letter into consonants and vowels.
 // ex - '곿까ㅒㄷ' -> 'ㄱㅗㅏㄱㅅㄲㅏㅒㄷ'
 std::wstring normalize_hangeul(std::wstring_view str);
+// Same as above, but into `result` so that its memory can be reused.
+void normalize_hangeul(std::wstring_view str, std::wstring& result);
+// Same as above, but without any allocation. Writes as many letters as `result` can hold,
+// and returns the length of the whole normalized string, so an empty `result` only measures it.
+size_t normalize_hangeul(std::wstring_view str, std::span<wchar_t> result);
 
 // Exact opposite of `normalize_hangeul`.
 // ex - ㄱㅗㅏㄱㅅㄲㅏㅒㄷ' -> '곿까ㅒㄷ'
 std::wstring combine_hangeul(std::wstring_view str);
 
 std::wstring alphabet_to_hangeul(std::wstring_view str);
+// Same as above, but without any allocation. Each letter is converted into exactly one letter.
+size_t alphabet_to_hangeul(std::wstring_view str, std::span<wchar_t> result);
 
 std::wstring hangeul_to_alphabet(std::wstring_view normalizedStr, bool isCapsLockOn);
+// Same as above, but into `result` so that its memory can be reused.
+void hangeul_to_alphabet(std::wstring_view normalizedStr, bool isCapsLockOn, std::wstring& result);
+// Same as above, but without any allocation. Each letter is converted into exactly one letter.
+size_t hangeul_to_alphabet(std::wstring_view normalizedStr, bool isCapsLockOn, std::span<wchar_t> result);
 
 constexpr bool is_korean(wchar_t c);
 
@@ -0,0 +1,20 @@
+#include "../../Typoon/low_level/compression.h"
+
+
+// Stored as they are, the tests only care about the format around it.
+bool compress_bytes(std::span<const std::byte> data, std::vector<std::byte>& compressed)
+{
+    compressed.assign(data.begin(), data.end());
+    return true;
+}
+
+
+bool decompress_bytes(std::span<const std::byte> compressed, size_t rawSize, std::vector<std::byte>& data)
+{
+    if (compressed.size() != rawSize)
+    {
+        return false;
+    }
+    data.assign(compressed.begin(), compressed.end());
+    return true;
+}
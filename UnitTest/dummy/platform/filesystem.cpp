@@ -0,0 +1,9 @@
+#include "../../Typoon/low_level/filesystem.h"
+
+
+const std::filesystem::path& get_cache_directory_path()
+{
+    // Don't cache anything in the tests.
+    static const std::filesystem::path cachePath;
+    return cachePath;
+}
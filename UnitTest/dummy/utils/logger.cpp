@@ -1,9 +1,16 @@
 #include "../../Typoon/utils/logger.h"
 
+#include "../../Typoon/utils/log_rotation.h"
+
 
 Logger::Logger(LogLevel)
 {}
 
 Logger::~Logger() = default;
 
-void Logger::Log(const std::wstring&, LogLevel) {}
+void Logger::Flush(std::chrono::milliseconds) {}
+
+void Logger::push(LogRecord& record)
+{
+    record.arguments.Release();
+}
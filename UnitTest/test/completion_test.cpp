@@ -0,0 +1,49 @@
+#include <doctest.h>
+
+#include <thread>
+
+#include "../../Typoon/utils/completion.h"
+
+
+TEST_SUITE("Completion")
+{
+    TEST_CASE("Wait & Then")
+    {
+        Completion completion;
+        int callCount = 0;
+        const auto lambdaOnFinish = [&callCount]() { callCount++; };
+
+        SUBCASE("Not Started")
+        {
+            completion.Then(lambdaOnFinish);
+            CHECK(callCount == 1);
+            completion.Wait();
+        }
+
+        SUBCASE("Finished in Another Thread")
+        {
+            completion.Start();
+            completion.Then(lambdaOnFinish);
+            CHECK(callCount == 0);
+            CHECK_FALSE(completion.IsFinished());
+
+            std::jthread thread{ [&completion]() { completion.Finish(); } };
+            completion.Wait();
+            thread.join();
+            CHECK(callCount == 1);
+        }
+
+        SUBCASE("Restarted")
+        {
+            completion.Start();
+            completion.Then(lambdaOnFinish);
+            completion.Start();
+            CHECK(callCount == 0);
+
+            completion.Finish();
+            CHECK(callCount == 1);
+            completion.Finish();
+            CHECK(callCount == 1);
+        }
+    }
+}
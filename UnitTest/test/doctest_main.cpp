@@ -1,2 +1,23 @@
-#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
-#include <doctest.h>
\ No newline at end of file
+#define DOCTEST_CONFIG_IMPLEMENT
+#include <doctest.h>
+
+#include "../util/test_util.h"
+
+
+int main(int argc, char** argv)
+{
+    // Every engine should produce exactly the same results, so run the whole tests against each of them.
+    int result = 0;
+    for (const Config::EMatchEngine engine : { Config::EMatchEngine::AGENTS, Config::EMatchEngine::AUTOMATON })
+    {
+        test_match_engine = engine;
+
+        doctest::Context context{ argc, argv };
+        result |= context.run();
+        if (context.shouldExit())
+        {
+            break;
+        }
+    }
+    return result;
+}
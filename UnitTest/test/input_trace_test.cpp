@@ -0,0 +1,60 @@
+#include <doctest.h>
+
+#include <fstream>
+
+#include "../../Typoon/input_multicast/input_trace.h"
+#include "../util/test_util.h"
+
+
+TEST_SUITE("Input Trace")
+{
+    TEST_CASE("Capture & Read")
+    {
+        const std::filesystem::path directory = std::filesystem::temp_directory_path() / "typoon_input_trace_test";
+        std::filesystem::create_directories(directory);
+        const std::filesystem::path traceFile = directory / "trace.bin";
+
+        REQUIRE(start_input_capture(traceFile));
+        CHECK(is_capturing_input());
+        multicast_input({ { .letter = L'a' } }, 1);
+        multicast_input({ { .letter = L'가' }, { .letter = L'ㄴ', .isBeingComposed = true } }, 2);
+        multicast_input({}, 0, true);
+        stop_input_capture();
+        CHECK(!is_capturing_input());
+        // Not captured anymore.
+        multicast_input({ { .letter = L'b' } }, 1);
+
+        std::vector<InputTraceEvent> events;
+        REQUIRE(read_input_trace(traceFile, events));
+        REQUIRE(events.size() == 3);
+        CHECK(events[0].length == 1);
+        CHECK(events[0].inputs[0].letter == L'a');
+        CHECK(!events[0].inputs[0].isBeingComposed);
+        CHECK(!events[0].clearAllAgents);
+        CHECK(events[1].length == 2);
+        CHECK(events[1].inputs[0].letter == L'가');
+        CHECK(!events[1].inputs[0].isBeingComposed);
+        CHECK(events[1].inputs[1].letter == L'ㄴ');
+        CHECK(events[1].inputs[1].isBeingComposed);
+        CHECK(events[2].length == 0);
+        CHECK(events[2].clearAllAgents);
+        CHECK(events[0].time <= events[1].time);
+        CHECK(events[1].time <= events[2].time);
+
+        SUBCASE("Broken")
+        {
+            std::ifstream ifs{ traceFile, std::ios::binary };
+            std::string content{ std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>() };
+            ifs.close();
+
+            // Cut in the middle of the letters of the last input.
+            std::ofstream{ traceFile, std::ios::binary | std::ios::trunc }.write(content.data(), static_cast<std::streamsize>(content.size() - 3));
+            CHECK(!read_input_trace(traceFile, events));
+
+            std::ofstream{ traceFile, std::ios::binary | std::ios::trunc } << "TYTC";
+            CHECK(!read_input_trace(traceFile, events));
+        }
+
+        std::filesystem::remove_all(directory);
+    }
+}
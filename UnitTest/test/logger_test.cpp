@@ -0,0 +1,310 @@
+#include <doctest.h>
+
+#include <algorithm>
+#include <fstream>
+#include <ranges>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "../../Typoon/utils/binary_log.h"
+#include "../../Typoon/utils/log_arguments.h"
+#include "../../Typoon/utils/log_rotation.h"
+#include "../../Typoon/utils/mpsc_ring_buffer.h"
+
+
+template<typename ...Ts>
+std::wstring format_log_arguments(const Ts& ...ts)
+{
+    LogArguments arguments;
+    (arguments.Append(ts), ...);
+    std::wstring line;
+    arguments.AppendTo(line);
+    arguments.Release();
+    return line;
+}
+
+
+TEST_SUITE("Logger")
+{
+    TEST_CASE("MPSC Ring Buffer")
+    {
+        SUBCASE("Full & Empty")
+        {
+            MpscRingBuffer<int, 4> buffer;
+            int value = 0;
+            CHECK(!buffer.TryPop(value));
+            for (int i = 0; i < 4; i++)
+            {
+                CHECK(buffer.TryPush(i));
+            }
+            CHECK(!buffer.TryPush(4));
+
+            // Wraps around once there's room.
+            CHECK(buffer.TryPop(value));
+            CHECK(value == 0);
+            CHECK(buffer.TryPush(4));
+            for (int i = 1; i <= 4; i++)
+            {
+                CHECK(buffer.TryPop(value));
+                CHECK(value == i);
+            }
+            CHECK(!buffer.TryPop(value));
+            CHECK(buffer.GetPushCount() == 5);
+        }
+
+        SUBCASE("Multiple Producers")
+        {
+            constexpr int producerCount = 4;
+            constexpr int pushCount = 20000;
+            MpscRingBuffer<std::pair<int, int>, 64> buffer;
+
+            std::vector<std::jthread> producers;
+            for (int producer = 0; producer < producerCount; producer++)
+            {
+                producers.emplace_back([&buffer, producer]
+                    {
+                        for (int i = 0; i < pushCount; i++)
+                        {
+                            while (!buffer.TryPush({ producer, i }))
+                            {
+                                std::this_thread::yield();
+                            }
+                        }
+                    });
+            }
+
+            // Every push is popped once, in the order of each producer.
+            std::vector<int> nextValues(producerCount, 0);
+            bool isInOrder = true;
+            for (int popCount = 0; popCount < producerCount * pushCount;)
+            {
+                std::pair<int, int> value;
+                if (buffer.TryPop(value))
+                {
+                    isInOrder = isInOrder && value.second == nextValues[value.first];
+                    nextValues[value.first]++;
+                    popCount++;
+                }
+            }
+            CHECK(isInOrder);
+            CHECK(std::ranges::all_of(nextValues, [](int next) { return next == pushCount; }));
+        }
+    }
+
+    TEST_CASE("Log Arguments")
+    {
+        SUBCASE("Types")
+        {
+            CHECK(format_log_arguments(L"input:", L'가', 3, true) == L"input: 가 3 true");
+            CHECK(format_log_arguments("narrow", std::string{ "string" }, std::wstring_view{ L"view" }) == L"narrow string view");
+            CHECK(format_log_arguments(-1LL, 18446744073709551615ULL, 0.5) == L"-1 18446744073709551615 " + std::to_wstring(0.5));
+            CHECK(format_log_arguments(std::filesystem::path{ "a/b.json5" }) == L"a/b.json5");
+            CHECK(format_log_arguments().empty());
+        }
+
+        SUBCASE("Long Strings")
+        {
+            // Too long to fit, moved to the heap.
+            const std::wstring longString(LogArguments::CAPACITY, L'x');
+            CHECK(format_log_arguments(L"a", longString, L"b") == L"a " + longString + L" b");
+            CHECK(format_log_arguments(std::string(LogArguments::CAPACITY, 'y')) == std::wstring(LogArguments::CAPACITY, L'y'));
+
+            // Left out once there's no room even for a pointer.
+            std::vector<std::wstring> strings(LogArguments::CAPACITY, L"z");
+            LogArguments arguments;
+            for (const std::wstring& string : strings)
+            {
+                arguments.Append(string);
+            }
+            std::wstring line;
+            arguments.AppendTo(line);
+            arguments.Release();
+            CHECK(line.starts_with(L"z z z"));
+            CHECK(line.ends_with(L" ..."));
+            CHECK(arguments.IsEmpty());
+        }
+    }
+
+    TEST_CASE("Binary Log")
+    {
+        static_assert(!IsLogLevelCompiledOut<LogLevel::ELogLevel::ERROR>);
+        static_assert(IsLogLevelCompiledOut<LogLevel::ELogLevel::MIN>);
+
+        const std::filesystem::path directory = std::filesystem::temp_directory_path() / "typoon_logger_test";
+        std::filesystem::create_directories(directory);
+        const std::filesystem::path logFile = directory / "log.tylog";
+        std::filesystem::remove(logFile);
+
+        const auto time = std::chrono::system_clock::time_point{ std::chrono::seconds{ 1700000000 } };
+        const auto lambdaWrite = [time](BinaryLogWriter& writer, LogLevel logLevel, unsigned int line, const auto& ...ts)
+            {
+                LogRecord record{ time, logLevel, line, "a.cpp" };
+                (record.arguments.Append(ts), ...);
+                writer.Write(record);
+                record.arguments.Release();
+            };
+
+        const std::wstring longString(LogArguments::CAPACITY, L'x');
+        {
+            BinaryLogWriter writer{ logFile };
+            REQUIRE(writer.IsGood());
+            lambdaWrite(writer, ELogLevel::INFO, 1, "first", 1);
+            lambdaWrite(writer, ELogLevel::ERROR, 2, L"second", longString);
+            lambdaWrite(writer, ELogLevel::INFO, 1, "third");
+        }
+        {
+            // A session cut in the middle of a record, by a crash.
+            std::ofstream ofs{ logFile, std::ios::binary | std::ios::app };
+            ofs.write("TYLG\x01\0\0\0\x02\0", 10);
+        }
+        {
+            // Appended as another session, in which the sites start over.
+            BinaryLogWriter writer{ logFile };
+            lambdaWrite(writer, ELogLevel::WARNING, 3, "fourth", true);
+        }
+
+        std::vector<std::tuple<LogLevel, unsigned int, std::wstring>> entries;
+        const bool isValid = read_binary_log(logFile, [&entries, time](const BinaryLogEntry& entry)
+            {
+                std::wstring line;
+                CHECK(append_log_arguments(entry.arguments, line));
+                CHECK(entry.file == "a.cpp");
+                CHECK(entry.time == time);
+                entries.emplace_back(entry.logLevel, entry.line, std::move(line));
+            });
+        REQUIRE(isValid);
+        REQUIRE(entries.size() == 4);
+        CHECK(entries[0] == std::tuple<LogLevel, unsigned int, std::wstring>{ ELogLevel::INFO, 1, L"first 1" });
+        CHECK(entries[1] == std::tuple<LogLevel, unsigned int, std::wstring>{ ELogLevel::ERROR, 2, L"second " + longString });
+        CHECK(entries[2] == std::tuple<LogLevel, unsigned int, std::wstring>{ ELogLevel::INFO, 1, L"third" });
+        CHECK(entries[3] == std::tuple<LogLevel, unsigned int, std::wstring>{ ELogLevel::WARNING, 3, L"fourth true" });
+
+        CHECK(!read_binary_log(std::span<const std::byte>{}, [](const BinaryLogEntry&) {}));
+        std::filesystem::remove_all(directory);
+    }
+
+    TEST_CASE("Log Rotation")
+    {
+        const std::filesystem::path directory = std::filesystem::temp_directory_path() / "typoon_log_rotation_test";
+        std::filesystem::remove_all(directory);
+        std::filesystem::create_directories(directory);
+        const std::filesystem::path logFile = directory / "log.tylog";
+        // Rotated long before `maxSegmentAge`.
+        std::ofstream{ directory / "log.1000.tylz" } << "old";
+
+        const auto now = std::chrono::system_clock::now();
+        const auto lambdaWrite = [](auto& writer, std::chrono::system_clock::time_point time, int i)
+            {
+                LogRecord record{ time, ELogLevel::INFO, 1, "a.cpp" };
+                record.arguments.Append("log");
+                record.arguments.Append(i);
+                writer.Write(record);
+            };
+        const auto lambdaReadFrames = [](std::span<const std::byte> frame, std::vector<std::wstring>& lines)
+            {
+                read_binary_log(frame, [&lines](const BinaryLogEntry& entry)
+                    {
+                        append_log_arguments(entry.arguments, lines.emplace_back());
+                    });
+            };
+
+        const LogRotationOptions options{ .maxFileSize = 1024 };
+        {
+            RotatingBinaryLog log{ logFile, options };
+            for (int i = 0; i < 200; i++)
+            {
+                lambdaWrite(log, now, i);
+            }
+            log.WaitForBackgroundWork();
+            const size_t segmentCount = find_log_segments(logFile).size();
+            CHECK(segmentCount >= 4);
+
+            // Rotated by the time, before it's written.
+            lambdaWrite(log, now + std::chrono::days{ 2 }, 200);
+            log.Flush();
+            log.WaitForBackgroundWork();
+            const std::vector<std::filesystem::path> segments = find_log_segments(logFile);
+            CHECK(segments.size() == segmentCount + 1);
+            CHECK(std::ranges::none_of(segments, [](const auto& segment) { return segment.filename() == "log.1000.tylz"; }));
+
+            std::vector<std::wstring> lines;
+            for (const std::filesystem::path& segment : segments)
+            {
+                CHECK(segment.extension() == ".tylz");
+                std::vector<std::vector<std::byte>> frames;
+                CHECK(read_compressed_log_backward(segment, [&frames](std::span<const std::byte> frame)
+                    {
+                        frames.emplace_back(frame.begin(), frame.end());
+                        return true;
+                    }));
+                for (const std::vector<std::byte>& frame : frames | std::views::reverse)
+                {
+                    lambdaReadFrames(frame, lines);
+                }
+            }
+            std::ifstream ifs{ logFile, std::ios::binary };
+            const std::vector<char> active{ std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>() };
+            lambdaReadFrames(std::as_bytes(std::span{ active }), lines);
+
+            REQUIRE(lines.size() == 201);
+            for (int i = 0; i <= 200; i++)
+            {
+                CHECK(lines[i] == L"log " + std::to_wstring(i));
+            }
+        }
+
+        SUBCASE("Frames")
+        {
+            // Larger than a frame, so that it takes several of them.
+            const std::filesystem::path segment = directory / "big.tylog";
+            for (int session = 0; session < 2; session++)
+            {
+                BinaryLogWriter writer{ segment };
+                for (int i = 0; i < 10000; i++)
+                {
+                    lambdaWrite(writer, now, session * 10000 + i);
+                }
+            }
+            REQUIRE(compress_log_segment(segment, directory / "big.tylz"));
+
+            std::vector<std::wstring> lines;
+            int frameCount = 0;
+            CHECK(read_compressed_log_backward(directory / "big.tylz", [&](std::span<const std::byte> frame)
+                {
+                    frameCount++;
+                    lambdaReadFrames(frame, lines);
+                    return true;
+                }));
+            CHECK(frameCount >= 2);
+            CHECK(lines.size() == 20000);
+
+            // Tailing reads only the last frame.
+            lines.clear();
+            CHECK(read_compressed_log_backward(directory / "big.tylz", [&](std::span<const std::byte> frame)
+                {
+                    lambdaReadFrames(frame, lines);
+                    return false;
+                }));
+            CHECK(!lines.empty());
+            CHECK(lines.back() == L"log 19999");
+            CHECK(!read_compressed_log_backward(segment, [](std::span<const std::byte>) { return true; }));
+
+            // A cut one fails, instead of looking like an empty one.
+            std::filesystem::copy_file(directory / "big.tylz", directory / "cut.tylz");
+            std::filesystem::resize_file(directory / "cut.tylz", std::filesystem::file_size(directory / "cut.tylz") - 1);
+            CHECK(!read_compressed_log_backward(directory / "cut.tylz", [](std::span<const std::byte>) { return true; }));
+            std::ofstream{ directory / "cut.tylz", std::ios::binary | std::ios::trunc }.write("TYLZ\x01\0\0\0\0", 9);
+            CHECK(!read_compressed_log_backward(directory / "cut.tylz", [](std::span<const std::byte>) { return true; }));
+        }
+
+        SUBCASE("Pruned by the total size")
+        {
+            RotatingBinaryLog log{ logFile, { .maxTotalSize = 1 } };
+            log.WaitForBackgroundWork();
+            CHECK(find_log_segments(logFile).empty());
+        }
+
+        std::filesystem::remove_all(directory);
+    }
+}
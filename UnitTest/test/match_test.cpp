@@ -1,6 +1,7 @@
 ﻿#include <doctest.h>
 
 #include "../../Typoon/match/trigger_tree.h"
+#include "../../Typoon/match/trigger_tree_builder.h"
 #include "../util/test_util.h"
 
 
@@ -49,6 +50,21 @@ TEST_SUITE("Match")
             check_text_editor_simulator({ L"나가 나가나가나가ㄷㄷ|_|ㅏ", true });
         }
 
+        SUBCASE("Too Long Counts")
+        {
+            // The backspaces or the cursor moves wouldn't fit in the ending, so those are skipped.
+            const std::u8string tooLong(70000, u8'z');
+            reconstruct_trigger_tree_with_u8string(u8"{ matches: ["
+                u8"{ trigger: 'ab" + tooLong + u8"', replace: 'x' },"
+                u8"{ trigger: 'cd', replace: 'x|_|" + tooLong + u8"' },"
+                u8"{ trigger: 'ef', replace: 'y' },"
+                u8"] }");
+            wait_for_trigger_tree_construction();
+
+            simulate_type(L"ab cd ef");
+            check_text_editor_simulator({ L"ab cd y" });
+        }
+
         end_match_test_case();
     }
 
@@ -278,6 +294,37 @@ b',
             check_text_editor_simulator({ L"triggered triggered triggered TRIGGERED TRIGGERED TRIGGERED tRiGgErEd tRiGgErEd tRiGgErEd" });
         }
 
+        SUBCASE("Same Letters With Different Cases")
+        {
+            reconstruct_trigger_tree_with_u8string(u8R"({
+                matches: [
+                    {
+                        trigger: 'Ab',
+                        replace: 'first',
+                        case_sensitive: true,
+                    },
+                    {
+                        trigger: 'ab',
+                        replace: 'second',
+                        case_sensitive: true,
+                    },
+                    {
+                        trigger: 'aB',
+                        replace: 'third',
+                    },
+                    {
+                        trigger: 'AB',
+                        replace: 'fourth',
+                        case_sensitive: true,
+                    }
+                ]
+            })");
+            wait_for_trigger_tree_construction();
+
+            simulate_type(L"Ab ab aB AB");
+            check_text_editor_simulator({ L"first second third fourth" });
+        }
+
         end_match_test_case();
     }
 
@@ -758,6 +805,34 @@ TEST_SUITE("Config")
             check_text_editor_simulator({ L"apple" });
         }
 
+        SUBCASE("Revived Agents")
+        {
+            start_match_test_case(config);
+
+            // 'xab' survives the 'q' while 'b' dies, and both reach an ending on the 'y' after the backspace.
+            // The revived one is checked after the others, so the longer one wins unlike without the 'q'.
+            reconstruct_trigger_tree_with_u8string(u8R"({
+                    matches: [
+                        {
+                            trigger: 'xaby',
+                            replace: '1',
+                        },
+                        {
+                            trigger: 'xabqz',
+                            replace: '2',
+                        },
+                        {
+                            trigger: 'by',
+                            replace: '3',
+                        },
+                    ]
+                })");
+            wait_for_trigger_tree_construction();
+
+            simulate_type(L"xaby xabq\by");
+            check_text_editor_simulator({ L"xa3 1" });
+        }
+
         end_match_test_case();
     }
 
@@ -813,4 +888,162 @@ TEST_SUITE("Config")
 
         end_match_test_case();
     }
+
+    TEST_CASE("Incremental Reconstruction")
+    {
+        start_match_test_case();
+
+        SUBCASE("Changed Matches")
+        {
+            reconstruct_trigger_tree_with_u8string(u8R"({
+                matches: [
+                    {
+                        trigger: 'calender',
+                        replace: 'calendar'
+                    },
+                    {
+                        trigger: 'teh',
+                        replace: 'the'
+                    },
+                    {
+                        trigger: 'recieve',
+                        replace: 'receive'
+                    }
+                ]
+            })");
+            wait_for_trigger_tree_construction();
+
+            reconstruct_trigger_tree_incrementally_with_u8string(u8R"({
+                matches: [
+                    {
+                        trigger: 'calender',
+                        replace: 'calendar'
+                    },
+                    {
+                        trigger: 'teh',
+                        replace: 'THE'
+                    },
+                    {
+                        trigger: 'adn',
+                        replace: 'and'
+                    }
+                ]
+            })");
+            wait_for_trigger_tree_construction();
+
+            simulate_type(L"calender teh adn recieve");
+            check_text_editor_simulator({ L"calendar THE and recieve" });
+        }
+
+        SUBCASE("Hidden Triggers")
+        {
+            reconstruct_trigger_tree_with_u8string(u8R"({
+                matches: [
+                    {
+                        trigger: 'abc',
+                        replace: 'long'
+                    },
+                    {
+                        trigger: 'ab',
+                        replace: 'short'
+                    },
+                    {
+                        trigger: 'xy',
+                        replace: 'first'
+                    },
+                    {
+                        trigger: 'xy',
+                        replace: 'second'
+                    }
+                ]
+            })");
+            wait_for_trigger_tree_construction();
+
+            simulate_type(L"abc xy");
+            check_text_editor_simulator({ L"shortc first" });
+
+            teardown_imm_simulator();
+            setup_imm_simulator();
+            text_editor_simulator.Reset();
+
+            // The hidden triggers should be revealed once the ones hiding them are removed.
+            reconstruct_trigger_tree_incrementally_with_u8string(u8R"({
+                matches: [
+                    {
+                        trigger: 'abc',
+                        replace: 'long'
+                    },
+                    {
+                        trigger: 'xy',
+                        replace: 'second'
+                    }
+                ]
+            })");
+            wait_for_trigger_tree_construction();
+
+            simulate_type(L"abc xy");
+            check_text_editor_simulator({ L"long second" });
+        }
+
+        SUBCASE("Replace Strings Of Removed Matches")
+        {
+            // Every save changes the replace, which would grow the pool forever without compacting it.
+            const auto lambdaMakeMatchFiles = [](int version)
+                {
+                    return std::vector{ MatchFile{ "matches.json5", { Match{ .triggers = { L"teh" }, .replace = L"the " + std::to_wstring(version), .doPropagateCase = true } } } };
+                };
+            TriggerTreeBuilder builder;
+            REQUIRE(builder.Build(lambdaMakeMatchFiles(0), {}));
+            for (int version = 1; version <= 1000; version++)
+            {
+                REQUIRE(builder.Update(lambdaMakeMatchFiles(version), {}));
+            }
+            CHECK(builder.GetReplaceStrings().size() <= 2 * 3 * std::wstring_view{ L"the 1000" }.size());
+
+            CompiledTriggerTree tree;
+            builder.Flatten(tree);
+            REQUIRE(tree.endings.size() == 1);
+            const Ending& ending = tree.endings.front();
+            CHECK(std::wstring_view{ builder.GetReplaceStrings() }.substr(ending.replaceStringIndex, ending.replaceStringLength * 3) == L"the 1000The 1000THE 1000");
+        }
+
+        end_match_test_case();
+    }
+
+    TEST_CASE("Replace Buffers")
+    {
+        start_match_test_case();
+
+        SUBCASE("No Growth Once Big Enough")
+        {
+            reconstruct_trigger_tree_with_u8string(u8R"({
+                matches: [
+                    {
+                        trigger: 'teh',
+                        replace: 'the',
+                        propagate_case: true
+                    },
+                    {
+                        trigger: '가나',
+                        replace: '다라',
+                        full_composite: true
+                    },
+                    {
+                        trigger: '스빈다',
+                        replace: '습니다',
+                        keep_composite: true,
+                    }
+                ]
+            })");
+            wait_for_trigger_tree_construction();
+
+            simulate_type(L"Teh 가나카 알겠스빈다 ");
+            const size_t growthCount = get_replace_buffer_growth_count();
+            simulate_type(L"TEH 가나카 알겠스빈다 teh 가나카 알겠스빈다 ");
+            CHECK(get_replace_buffer_growth_count() == growthCount);
+            check_text_editor_simulator({ L"The 다라카 알겠습니다 THE 다라카 알겠습니다 the 다라카 알겠습니다 " });
+        }
+
+        end_match_test_case();
+    }
 }
@@ -0,0 +1,99 @@
+#include <doctest.h>
+
+#include <fstream>
+#include <thread>
+
+#include "../../Typoon/parse/parse_match.h"
+#include "../util/config.h"
+#include "../util/test_util.h"
+
+
+TEST_SUITE("Parse Match")
+{
+    TEST_CASE("Imports")
+    {
+        set_config(default_config);
+        invalidate_all_matches_cache();
+
+        const std::filesystem::path directory = std::filesystem::temp_directory_path() / "typoon_parse_match_test";
+        std::filesystem::remove_all(directory);
+        std::filesystem::create_directories(directory);
+        const auto lambdaWriteMatchFile = [&directory](std::string_view name, std::string_view imports)
+            {
+                std::ofstream ofs{ directory / name, std::ios::binary | std::ios::trunc };
+                ofs << "{ imports: [" << imports << "], matches: [{ trigger: '" << name << "', replace: 'x' }] }";
+                return (directory / name).lexically_normal();
+            };
+        const auto lambdaGetFiles = [](const std::vector<MatchFileForParse>& matchFiles)
+            {
+                std::vector<std::filesystem::path> files;
+                for (const MatchFileForParse& matchFile : matchFiles)
+                {
+                    files.emplace_back(matchFile.file);
+                }
+                return files;
+            };
+
+        SUBCASE("Order")
+        {
+            // The imported matches come first, in the order of the imports.
+            const std::filesystem::path c = lambdaWriteMatchFile("c.json5", "");
+            const std::filesystem::path a = lambdaWriteMatchFile("a.json5", "'c.json5'");
+            const std::filesystem::path b = lambdaWriteMatchFile("b.json5", "'c.json5'");
+            const std::filesystem::path main = lambdaWriteMatchFile("main.json5", "'a.json5', 'b.json5'");
+
+            const auto [matchFiles, importedFiles] = parse_matches(main, {}, {});
+            CHECK(lambdaGetFiles(matchFiles) == std::vector{ c, a, b, main });
+            CHECK(importedFiles.size() == 4);
+            REQUIRE(matchFiles.back().matches.size() == 1);
+            CHECK(matchFiles.back().matches.front().trigger == "main.json5");
+        }
+
+        SUBCASE("Circular Imports")
+        {
+            const std::filesystem::path a = lambdaWriteMatchFile("a.json5", "'b.json5'");
+            const std::filesystem::path b = lambdaWriteMatchFile("b.json5", "'a.json5'");
+            const std::filesystem::path main = lambdaWriteMatchFile("main.json5", "'a.json5', 'main.json5'");
+
+            const auto [matchFiles, importedFiles] = parse_matches(main, {}, {});
+            CHECK(lambdaGetFiles(matchFiles) == std::vector{ b, a, main });
+            CHECK(importedFiles.size() == 3);
+        }
+
+        SUBCASE("Concurrent Loading")
+        {
+            // Many files sharing the imports, parsed by many trigger trees at once, should give the same result as one by one.
+            constexpr int FILE_COUNT = 32;
+            lambdaWriteMatchFile("shared.json5", "");
+            std::string mainImports;
+            for (int i = 0; i < FILE_COUNT; i++)
+            {
+                const std::string name = "file" + std::to_string(i) + ".json5";
+                lambdaWriteMatchFile(name, i > 0 ? "'shared.json5', 'file" + std::to_string(i - 1) + ".json5'" : "'shared.json5'");
+                mainImports += "'" + name + "',";
+            }
+            const std::filesystem::path main = lambdaWriteMatchFile("main.json5", mainImports);
+
+            const std::vector<std::filesystem::path> expected = lambdaGetFiles(parse_matches(main, {}, {}).first);
+            REQUIRE(expected.size() == FILE_COUNT + 2);
+
+            constexpr int THREAD_COUNT = 8;
+            std::vector<std::vector<std::filesystem::path>> results(THREAD_COUNT);
+            invalidate_all_matches_cache();
+            {
+                std::vector<std::jthread> threads;
+                for (int i = 0; i < THREAD_COUNT; i++)
+                {
+                    threads.emplace_back([&, i]() { results[i] = lambdaGetFiles(parse_matches(main, {}, {}).first); });
+                }
+            }
+            for (const std::vector<std::filesystem::path>& result : results)
+            {
+                CHECK(result == expected);
+            }
+        }
+
+        invalidate_all_matches_cache();
+        std::filesystem::remove_all(directory);
+    }
+}
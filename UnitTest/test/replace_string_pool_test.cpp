@@ -0,0 +1,101 @@
+#include <doctest.h>
+
+#include <string>
+
+#include "../../Typoon/match/replace_string_pool.h"
+
+
+TEST_SUITE("Replace String Pool")
+{
+    TEST_CASE("Sharing")
+    {
+        SUBCASE("Exact Duplicates")
+        {
+            ReplaceStringPool pool;
+            const int index = pool.Add(L"hello");
+            CHECK(pool.Add(L"world") == 5);
+            CHECK(pool.Add(L"hello") == index);
+            CHECK(pool.GetStrings() == L"helloworld");
+            CHECK(pool.GetAutomatonStateCount() == 0);
+        }
+
+        SUBCASE("Substrings")
+        {
+            ReplaceStringPool pool{ true };
+            CHECK(pool.Add(L"abracadabra") == 0);
+            CHECK(pool.Add(L"cad") == 4);
+            CHECK(pool.Add(L"bra") == 1);
+            CHECK(pool.Add(L"abra") == 0);
+            // Across the boundary of two strings added.
+            CHECK(pool.Add(L"xyz") == 11);
+            CHECK(pool.Add(L"raxy") == 9);
+            CHECK(pool.Add(L"abc") == 14);
+            CHECK(pool.GetStrings() == L"abracadabraxyzabc");
+
+            // Every substring is found where it first appears.
+            const std::wstring strings = pool.GetStrings();
+            for (size_t start = 0; start < strings.size(); start++)
+            {
+                for (size_t length = 1; start + length <= strings.size(); length++)
+                {
+                    const std::wstring substring = strings.substr(start, length);
+                    CHECK(pool.Add(substring) == static_cast<int>(strings.find(substring)));
+                }
+            }
+            CHECK(pool.GetStrings() == strings);
+        }
+
+        SUBCASE("Random Strings")
+        {
+            // Few letters, so that there are many repeats and clones in the automaton.
+            ReplaceStringPool pool{ true };
+            std::wstring expectedStrings;
+            unsigned int seed = 1;
+            for (int i = 0; i < 500; i++)
+            {
+                std::wstring str;
+                seed = seed * 1103515245 + 12345;
+                const unsigned int length = 1 + (seed >> 16) % 12;
+                for (unsigned int j = 0; j < length; j++)
+                {
+                    seed = seed * 1103515245 + 12345;
+                    str.push_back(static_cast<wchar_t>(L'a' + (seed >> 16) % 3));
+                }
+
+                // Appended only if it's not there yet.
+                if (expectedStrings.find(str) == std::wstring::npos)
+                {
+                    expectedStrings += str;
+                }
+                const int index = pool.Add(str);
+                CHECK(pool.GetStrings().substr(index, str.size()) == str);
+            }
+            CHECK(pool.GetStrings() == expectedStrings);
+        }
+
+        SUBCASE("No Sharing")
+        {
+            ReplaceStringPool pool{ false };
+            CHECK(pool.Add(L"abracadabra") == 0);
+            CHECK(pool.Add(L"cad") == 11);
+            CHECK(pool.Add(L"cad") == 11);
+            CHECK(pool.GetStrings() == L"abracadabracad");
+        }
+
+        SUBCASE("Released")
+        {
+            ReplaceStringPool pool{ true };
+            CHECK(pool.Add(L"abracadabra") == 0);
+            CHECK(pool.GetAutomatonStateCount() > 0);
+            pool.ReleaseSubstringIndex();
+            CHECK(pool.GetAutomatonStateCount() == 0);
+            CHECK(pool.Add(L"abracadabra") == 0);
+            CHECK(pool.Add(L"cad") == 11);
+
+            // Shared again once cleared.
+            pool.Clear();
+            CHECK(pool.Add(L"abracadabra") == 0);
+            CHECK(pool.Add(L"cad") == 4);
+        }
+    }
+}
@@ -1,5 +1,9 @@
 #include <doctest.h>
 
+#include <array>
+
+#include "../../Typoon/match/trigger_tree.h"
+#include "../../Typoon/utils/string.h"
 #include "../util/test_util.h"
 
 
@@ -42,5 +46,95 @@ TEST_SUITE("String Util")
             check_normalization(L"ㄳㄵㄶㄺㄻㄼㄽㄾㄿㅀㅄ", L"ㄱㅅㄴㅈㄴㅎㄹㄱㄹㅁㄹㅂㄹㅅㄹㅌㄹㅍㄹㅎㅂㅅ");
             check_normalization(L"갃꺉놚뙑럚뼯벐셡옲죯춦", L"ㄱㅏㄱㅅㄲㅑㄴㅈㄴㅗㅏㄴㅎㄸㅗㅐㄹㄱㄹㅒㄹㅁㅃㅖㄹㅂㅂㅓㄹㅅㅅㅕㄹㅌㅇㅗㄹㅍㅈㅛㄹㅎㅊㅜㅂㅅ");
         }
+
+        SUBCASE("Mixed With Long English")
+        {
+            check_normalization(L"The quick brown fox 갃 jumps over the lazy dog.꺉", L"The quick brown fox ㄱㅏㄱㅅ jumps over the lazy dog.ㄲㅑㄴㅈ");
+            check_normalization(L"가나다 abcdefghijklmnopqrstuvwxyz라", L"ㄱㅏㄴㅏㄷㅏ abcdefghijklmnopqrstuvwxyzㄹㅏ");
+        }
+
+        SUBCASE("Into A Short Buffer")
+        {
+            std::array<wchar_t, 4> buffer{};
+            CHECK(normalize_hangeul(L"a갃b", buffer) == 6);
+            CHECK(std::wstring_view{ buffer.data(), buffer.size() } == L"aㄱㅏㄱ");
+        }
+    }
+
+    TEST_CASE("Keyboard Layout Conversion")
+    {
+        SUBCASE("Alphabet To Hangeul")
+        {
+            CHECK(alphabet_to_hangeul(L"dkssudgktpdy, Typoon!") == L"ㅇㅏㄴㄴㅕㅇㅎㅏㅅㅔㅇㅛ, ㅆㅛㅔㅐㅐㅜ!");
+
+            std::wstring buffer(5, 0);
+            CHECK(alphabet_to_hangeul(L"QWERT", std::span{ buffer }) == 5);
+            CHECK(buffer == L"ㅃㅉㄸㄲㅆ");
+        }
+
+        SUBCASE("Hangeul To Alphabet")
+        {
+            CHECK(hangeul_to_alphabet(L"ㅇㅏㄴㄴㅕㅇ, Typoon!", false) == L"dkssud, Typoon!");
+            CHECK(hangeul_to_alphabet(L"ㅇㅏㄴㄴㅕㅇ, Typoon!", true) == L"DKSSUD, Typoon!");
+
+            std::wstring buffer(5, 0);
+            CHECK(hangeul_to_alphabet(L"ㅃㅉㄸㄲㅆ", true, std::span{ buffer }) == 5);
+            CHECK(buffer == L"qwert");
+        }
+    }
+
+    TEST_CASE("Character Properties")
+    {
+        SUBCASE("Case Folding")
+        {
+            CHECK(fold_case(L'A') == L'a');
+            CHECK(fold_case(L'a') == L'a');
+            CHECK(fold_case(L'Ä') == L'ä');
+            CHECK(fold_case(L'Ω') == L'ω');
+            CHECK(fold_case(L'Ａ') == L'ａ');
+            CHECK(fold_case(L'1') == L'1');
+            CHECK(fold_case(L'가') == L'가');
+        }
+
+        SUBCASE("Cased Alphabets")
+        {
+            CHECK(is_cased_alpha(L'z'));
+            CHECK(is_cased_alpha(L'Ж'));
+            CHECK_FALSE(is_cased_alpha(L'ǅ'));  // Titlecase
+            CHECK_FALSE(is_cased_alpha(L'ㄱ'));
+            CHECK_FALSE(is_cased_alpha(L'7'));
+        }
+
+        SUBCASE("Cases")
+        {
+            CHECK(is_upper(L'A'));
+            CHECK(is_upper(L'Ж'));
+            CHECK(is_lower(L'a'));
+            CHECK(is_lower(L'ж'));
+            CHECK_FALSE(is_upper(L'a'));
+            CHECK_FALSE(is_lower(L'A'));
+            CHECK_FALSE(is_upper(L'ǅ'));
+            CHECK_FALSE(is_lower(L'ǅ'));
+            CHECK_FALSE(is_upper(L'1'));
+            CHECK_FALSE(is_lower(L'가'));
+
+            CHECK(to_upper(L'a') == L'A');
+            CHECK(to_upper(L'A') == L'A');
+            CHECK(to_upper(L'ä') == L'Ä');
+            CHECK(to_upper(L'ω') == L'Ω');
+            CHECK(to_upper(L'ǅ') == L'ǅ');
+            CHECK(to_upper(L'1') == L'1');
+        }
+
+        SUBCASE("Alphanumerics")
+        {
+            CHECK(is_alnum(L'a'));
+            CHECK(is_alnum(L'0'));
+            CHECK(is_alnum(L'ㅏ'));
+            CHECK(is_alnum(L'힣'));
+            CHECK_FALSE(is_alnum(L' '));
+            CHECK_FALSE(is_alnum(L'!'));
+            CHECK_FALSE(is_alnum(Letter::NON_WORD_LETTER));
+        }
     }
 }
@@ -0,0 +1,155 @@
+#include <doctest.h>
+
+#include <cstddef>
+#include <fstream>
+#include <map>
+
+#include "../../Typoon/match/trigger_tree_cache.h"
+#include "../util/config.h"
+#include "../util/test_util.h"
+
+
+TEST_SUITE("Trigger Tree Cache")
+{
+    TEST_CASE("Save & Load")
+    {
+        set_config(default_config);
+
+        const std::filesystem::path directory = std::filesystem::temp_directory_path() / "typoon_trigger_tree_cache_test";
+        std::filesystem::create_directories(directory);
+        const std::filesystem::path matchFile = directory / "matches.json5";
+        const std::filesystem::path cacheFile = directory / "cache.bin";
+        const auto lambdaWriteMatchFile = [&matchFile](std::string_view content)
+            {
+                std::ofstream ofs{ matchFile, std::ios::binary | std::ios::trunc };
+                ofs << content;
+            };
+        constexpr std::string_view matchFileContent = "{ matches: [{ trigger: 'a', replace: 'b' }] }";
+        lambdaWriteMatchFile(matchFileContent);
+        const std::map<std::filesystem::path, unsigned long long> importedFiles{ { matchFile, hash_match_file_content(matchFileContent) } };
+
+        CompiledTriggerTree tree;
+        tree.nodes.resize(2);
+        REQUIRE(tree.nodes[0].SetChildren(0, { 1, 2 }));
+        tree.nodes[1].parentIndex = 0;
+        tree.nodes[1].SetLetter({ .letter = L'a' });
+        tree.nodes[1].SetEnding(0);
+        tree.endings = { { .replaceStringIndex = 0, .replaceStringLength = 1, .backspaceCount = 1 } };
+        tree.replaceStrings = L"b";
+        tree.height = 1;
+        REQUIRE(save_trigger_tree_cache(cacheFile, importedFiles, tree));
+
+        std::set<std::filesystem::path> loadedFiles;
+        CompiledTriggerTree loadedTree;
+        const auto lambdaLoad = [&]()
+            {
+                return load_trigger_tree_cache(cacheFile, loadedFiles, loadedTree);
+            };
+
+        SUBCASE("Unchanged")
+        {
+            REQUIRE(lambdaLoad());
+            CHECK(loadedFiles == std::set{ matchFile });
+            REQUIRE(loadedTree.nodes.size() == tree.nodes.size());
+            CHECK(loadedTree.GetChildren(loadedTree.nodes[0]) == ChildRange{ 1, 2 });
+            CHECK(loadedTree.nodes[1].letter == tree.nodes[1].letter);
+            CHECK(loadedTree.nodes[1].GetEndingIndex() == tree.nodes[1].GetEndingIndex());
+            REQUIRE(loadedTree.endings.size() == tree.endings.size());
+            CHECK(loadedTree.endings[0].backspaceCount == tree.endings[0].backspaceCount);
+            CHECK(loadedTree.replaceStrings == tree.replaceStrings);
+            CHECK(loadedTree.height == 1);
+        }
+
+        SUBCASE("Far Children")
+        {
+            // The children too far to be packed in the node.
+            CHECK_FALSE(tree.nodes[0].SetChildren(0, { 1 << 16, (1 << 16) + 1 }));
+            tree.farChildren = { { .nodeIndex = 0, .childBegin = 1, .childEnd = 2 } };
+            REQUIRE(save_trigger_tree_cache(cacheFile, importedFiles, tree));
+            REQUIRE(lambdaLoad());
+            CHECK(loadedTree.GetChildren(loadedTree.nodes[0]) == ChildRange{ 1, 2 });
+
+            tree.farChildren.clear();
+            REQUIRE(save_trigger_tree_cache(cacheFile, importedFiles, tree));
+            CHECK_FALSE(lambdaLoad());
+        }
+
+        SUBCASE("Match File Changed")
+        {
+            lambdaWriteMatchFile("{ matches: [{ trigger: 'a', replace: 'c' }] }");
+            CHECK_FALSE(lambdaLoad());
+        }
+
+        SUBCASE("Match File Changed While Parsing")
+        {
+            // Saved with the content parsed, not the one on the disk by then.
+            lambdaWriteMatchFile("{ matches: [{ trigger: 'a', replace: 'c' }] }");
+            REQUIRE(save_trigger_tree_cache(cacheFile, importedFiles, tree));
+            CHECK_FALSE(lambdaLoad());
+        }
+
+        SUBCASE("Config Changed")
+        {
+            Config config = default_config;
+            config.cursorPlaceholder = L"$|$";
+            set_config(config);
+            CHECK_FALSE(lambdaLoad());
+        }
+
+        SUBCASE("Broken Cache")
+        {
+            std::filesystem::resize_file(cacheFile, std::filesystem::file_size(cacheFile) - 1);
+            CHECK_FALSE(lambdaLoad());
+        }
+
+        SUBCASE("Corrupted Nodes")
+        {
+            // Each of them would index out of the tree in the matching.
+            const auto lambdaSaveCorrupted = [&](const auto& corrupt)
+                {
+                    CompiledTriggerTree corruptedTree = tree;
+                    corrupt(corruptedTree);
+                    REQUIRE(save_trigger_tree_cache(cacheFile, importedFiles, corruptedTree));
+                };
+
+            lambdaSaveCorrupted([](CompiledTriggerTree& corruptedTree) { corruptedTree.nodes[1].link = 0x80000000; });
+            CHECK_FALSE(lambdaLoad());
+            lambdaSaveCorrupted([](CompiledTriggerTree& corruptedTree) { corruptedTree.nodes[1].parentIndex = -2; });
+            CHECK_FALSE(lambdaLoad());
+            lambdaSaveCorrupted([](CompiledTriggerTree& corruptedTree) { corruptedTree.nodes[1].parentIndex = -1; });
+            CHECK_FALSE(lambdaLoad());
+            lambdaSaveCorrupted([](CompiledTriggerTree& corruptedTree) { corruptedTree.nodes[1].parentIndex = 1; });
+            CHECK_FALSE(lambdaLoad());
+            lambdaSaveCorrupted([](CompiledTriggerTree& corruptedTree) { corruptedTree.nodes[0].parentIndex = 0; });
+            CHECK_FALSE(lambdaLoad());
+        }
+
+        SUBCASE("Corrupted Endings")
+        {
+            // The ending is right before the replace strings at the end of the file.
+            const auto lambdaCorruptEndingByte = [&](size_t offset, unsigned char value)
+                {
+                    REQUIRE(save_trigger_tree_cache(cacheFile, importedFiles, tree));
+                    std::fstream fs{ cacheFile, std::ios::binary | std::ios::in | std::ios::out };
+                    fs.seekp(static_cast<std::streamoff>(std::filesystem::file_size(cacheFile) - tree.replaceStrings.size() * sizeof(wchar_t) - sizeof(Ending) + offset));
+                    fs.put(static_cast<char>(value));
+                };
+
+            lambdaCorruptEndingByte(offsetof(Ending, type), static_cast<unsigned char>(Ending::EReplaceType::COMMAND));
+            CHECK(lambdaLoad());
+            lambdaCorruptEndingByte(offsetof(Ending, type), static_cast<unsigned char>(Ending::EReplaceType::COMMAND) + 1);
+            CHECK_FALSE(lambdaLoad());
+            lambdaCorruptEndingByte(offsetof(Ending, uppercaseStyle), static_cast<unsigned char>(Match::EUppercaseStyle::WORDS) + 1);
+            CHECK_FALSE(lambdaLoad());
+            lambdaCorruptEndingByte(offsetof(Ending, propagateCase), 2);
+            CHECK_FALSE(lambdaLoad());
+            lambdaCorruptEndingByte(offsetof(Ending, keepComposite), 2);
+            CHECK_FALSE(lambdaLoad());
+            lambdaCorruptEndingByte(offsetof(Ending, replaceStringLength), 2);
+            CHECK_FALSE(lambdaLoad());
+        }
+
+        set_config(default_config);
+        std::filesystem::remove_all(directory);
+    }
+}
@@ -41,12 +41,24 @@ void reconstruct_trigger_tree_with_u8string(std::u8string_view text)
 }
 
 
+void reconstruct_trigger_tree_incrementally_with_u8string(std::u8string_view text)
+{
+    get_trigger_tree(DEFAULT_PROGRAM_NAME)->ReconstructIncrementally(std::string_view{ reinterpret_cast<const char*>(&text.front()), text.size() });
+}
+
+
 void wait_for_trigger_tree_construction()
 {
     get_trigger_tree(DEFAULT_PROGRAM_NAME)->WaitForConstruction();
 }
 
 
+size_t get_replace_buffer_growth_count()
+{
+    return get_trigger_tree(DEFAULT_PROGRAM_NAME)->GetReplaceBufferGrowthCount();
+}
+
+
 void check_text_editor_simulator(const TextState& textState)
 {
     CHECK(text_editor_simulator == textState);
@@ -56,12 +68,19 @@ void check_text_editor_simulator(const TextState& textState)
 void check_normalization(std::wstring_view original, std::wstring_view normalized)
 {
     CHECK(normalize_hangeul(original) == normalized);
+
+    std::wstring buffer(normalized.size(), 0);
+    CHECK(normalize_hangeul(original, {}) == normalized.size());
+    CHECK(normalize_hangeul(original, std::span{ buffer }) == normalized.size());
+    CHECK(buffer == normalized);
 }
 
 
 void start_match_test_case(const Config& config)
 {
-    set_config(config);
+    Config configWithEngine = config;
+    configWithEngine.matchEngine = test_match_engine;
+    set_config(std::move(configWithEngine));
     setup_trigger_trees("");
     set_current_program(DEFAULT_PROGRAM_NAME);
     setup_imm_simulator();
@@ -7,14 +7,20 @@
 
 
 inline Config default_config{.maxBackspaceCount = 5, .cursorPlaceholder = L"|_|" };
+// Overrides the engine of the config given to `start_match_test_case`, so that the same tests can be run against every engine.
+inline Config::EMatchEngine test_match_engine = Config::EMatchEngine::AGENTS;
 
 
 void simulate_type(std::wstring_view text);
 
 void reconstruct_trigger_tree_with_u8string(std::u8string_view text);
 
+void reconstruct_trigger_tree_incrementally_with_u8string(std::u8string_view text);
+
 void wait_for_trigger_tree_construction();
 
+size_t get_replace_buffer_growth_count();
+
 void check_text_editor_simulator(const TextState& textState);
 
 void check_normalization(std::wstring_view original, std::wstring_view normalized);
@@ -43,6 +43,7 @@ void TextEditorSimulator::Type(wchar_t letter)
 
 void TextEditorSimulator::Type(const std::vector<FakeInput>& inputs)
 {
+    mFakeInputsCount++;
     for (const auto& [type, letter] : inputs)
     {
         switch (type)
@@ -106,6 +107,7 @@ void TextEditorSimulator::Reset()
 {
     mText.clear();
     mCursorPos = 0;
+    mFakeInputsCount = 0;
     mImmSimulator.ClearComposition();
 }
 
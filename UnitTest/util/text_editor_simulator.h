@@ -27,6 +27,8 @@ public:
     [[nodiscard]] std::wstring GetText() const;
     [[nodiscard]] unsigned int GetCursorPos() const { return mCursorPos; }
     [[nodiscard]] bool IsLetterAtCursorInComposition() const;
+    // How many times the fake inputs were sent, i.e. the number of the replacements.
+    [[nodiscard]] size_t GetFakeInputsCount() const { return mFakeInputsCount; }
 
     [[nodiscard]] bool operator==(const TextState& textState) const;
 
@@ -37,6 +39,7 @@ private:
 private:
     std::wstring mText;
     unsigned int mCursorPos = 0;
+    size_t mFakeInputsCount = 0;
     ImmSimulator mImmSimulator;
 };
 